@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// Policies providing backing memory for the arena of custom_allocator.
+// A policy is a stateless type with static `void* allocate(size_t bytes)` and
+// `void deallocate(void* ptr, size_t bytes)`.
+
+
+// Default arena memory, 4 KiB pages from the system allocator
+struct malloc_arena {
+    static void* allocate(size_t bytes) {
+        return std::malloc(bytes);
+    }
+
+    static void deallocate(void* ptr, size_t) {
+        std::free(ptr);
+    }
+};
+
+
+#ifdef __linux__
+
+enum class huge_pages {
+    none,         // anonymous mmap with regular pages
+    transparent,  // madvise(MADV_HUGEPAGE), works with transparent_hugepage set to madvise or always
+    explicit_tlb  // MAP_HUGETLB from the reserved pool (vm.nr_hugepages), transparent if the pool is empty
+};
+
+// Arena memory mapped with mmap, optionally backed by 2 MiB pages and bound to a NUMA node.
+// Large node-based containers take far fewer TLB misses on huge pages. With Prefault every page
+// is touched on allocation, after the NUMA policy is set, so the first traversal does not fault.
+template<huge_pages Pages = huge_pages::transparent, int NumaNode = -1, bool Prefault = true>
+struct mmap_arena {
+    static constexpr size_t huge_page_size = size_t(2) << 20;
+
+    static void* allocate(size_t bytes) {
+        const size_t size = mapped_size(bytes);
+        void* ptr = MAP_FAILED;
+        if (Pages == huge_pages::explicit_tlb) {
+            ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (ptr == MAP_FAILED) {
+            ptr = map_aligned(size);
+            if (!ptr) {
+                return nullptr;
+            }
+            if (Pages != huge_pages::none) {
+                madvise(ptr, size, MADV_HUGEPAGE);
+            }
+        }
+        if (NumaNode >= 0 && !bind_to_node(ptr, size)) {
+            std::cerr << "mmap_arena failed to bind memory to NUMA node " << NumaNode << "\n";
+            munmap(ptr, size);
+            return nullptr;
+        }
+        if (Prefault) {
+            const long page = sysconf(_SC_PAGESIZE);
+            for (size_t off = 0; off < size; off += static_cast<size_t>(page)) {
+                static_cast<volatile char*>(ptr)[off] = 0;
+            }
+        }
+        return ptr;
+    }
+
+    static void deallocate(void* ptr, size_t bytes) {
+        munmap(ptr, mapped_size(bytes));
+    }
+
+private:
+    static size_t mapped_size(size_t bytes) {
+        if (Pages == huge_pages::none) {
+            return bytes;
+        }
+        return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    }
+
+    // Maps size bytes aligned to a huge page boundary, so the whole range can use huge pages
+    static void* map_aligned(size_t size) {
+        const size_t align = Pages == huge_pages::none ? 0 : huge_page_size;
+        void* raw = mmap(nullptr, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+        if (!align) {
+            return raw;
+        }
+        char* begin = static_cast<char*>(raw);
+        const size_t head = (align - reinterpret_cast<uintptr_t>(begin) % align) % align;
+        if (head) {
+            munmap(begin, head);
+        }
+        munmap(begin + head + size, align - head);
+        return begin + head;
+    }
+
+    // mbind(MPOL_BIND) without depending on libnuma
+    static bool bind_to_node(void* ptr, size_t size) {
+        constexpr int mpol_bind = 2;
+        unsigned long mask = 1ul << (NumaNode < 0 ? 0 : NumaNode);
+        static_assert(NumaNode < static_cast<int>(8 * sizeof(unsigned long)), "NUMA node is out of range");
+        return syscall(SYS_mbind, ptr, size, mpol_bind, &mask, 8 * sizeof(mask) + 1, 0) == 0;
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "custom_allocator.h"
+#include "custom_container.h"
+#include "custom_flat_map.h"
+#include "custom_queue.h"
+
+
+template<size_t N>
+using alloc_map_t = std::map<int, int, std::less<>, custom_allocator<std::pair<const int, int>, N>>;
+
+
+template<typename Map>
+static void BM_MapInsert(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    for (auto _: state) {
+        Map m;
+        for (int i = 0; i < n; ++i) {
+            m[i] = i;
+        }
+        benchmark::DoNotOptimize(m.size());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_MapInsert, std::map<int, int>)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_MapInsert, alloc_map_t<64>)->Arg(64);
+BENCHMARK_TEMPLATE(BM_MapInsert, alloc_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_MapInsert, alloc_map_t<8192>)->Arg(8192);
+
+template<typename Map>
+static void BM_MapLookup(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    Map m;
+    for (int i = 0; i < n; ++i) {
+        m[i] = i;
+    }
+    for (auto _: state) {
+        long sum = 0;
+        for (int i = 0; i < n; ++i) {
+            sum += m.find(i)->second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_MapLookup, std::map<int, int>)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_MapLookup, alloc_map_t<64>)->Arg(64);
+BENCHMARK_TEMPLATE(BM_MapLookup, alloc_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_MapLookup, alloc_map_t<8192>)->Arg(8192);
+
+template<typename List>
+static void BM_ListPushBack(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    for (auto _: state) {
+        List l;
+        for (int i = 0; i < n; ++i) {
+            l.push_back(i);
+        }
+        benchmark::DoNotOptimize(l.back());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_ListPushBack, custom_list<int>)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_ListPushBack, custom_list<int, custom_allocator<int, 64>>)->Arg(64);
+BENCHMARK_TEMPLATE(BM_ListPushBack, custom_list<int, custom_allocator<int, 1024>>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_ListPushBack, custom_list<int, custom_allocator<int, 8192>>)->Arg(8192);
+
+template<typename List>
+static void BM_ListIterate(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    List l;
+    for (int i = 0; i < n; ++i) {
+        l.push_back(i);
+    }
+    for (auto _: state) {
+        long sum = 0;
+        for (auto v: l) {
+            sum += v;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_ListIterate, custom_list<int>)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_ListIterate, custom_list<int, custom_allocator<int, 8192>>)->Arg(8192);
+
+template<typename Queue>
+static void BM_QueuePushPop(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    Queue q(n);
+    for (auto _: state) {
+        for (int i = 0; i < n; ++i) {
+            q.try_push(i);
+        }
+        int v = 0;
+        while (q.try_pop(v)) {}
+        benchmark::DoNotOptimize(v);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_QueuePushPop, custom_queue<int>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_QueuePushPop, custom_queue<int, custom_allocator<int, 1025>>)->Arg(1024);
+
+// Random-access traversal of node-based structures in large arenas, where TLB misses dominate:
+// the same access pattern over malloc memory, plain mmap, and mmap backed by huge pages (mmap_arena is Linux only)
+template<typename Arena>
+using arena_map_t = std::map<int, int, std::less<>, custom_allocator<std::pair<const int, int>, 1 << 18, Arena>>;
+
+template<typename Map>
+static void BM_MapRandomLookup(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    // the allocator with its occupancy table lives inside the map, too big for the stack
+    std::unique_ptr<Map> m(new Map);
+    for (int i = 0; i < n; ++i) {
+        (*m)[i] = i;
+    }
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    for (auto _: state) {
+        long sum = 0;
+        for (auto k: keys) {
+            sum += m->find(k)->second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_MapRandomLookup, arena_map_t<malloc_arena>)->Arg(1 << 18);
+#ifdef __linux__
+BENCHMARK_TEMPLATE(BM_MapRandomLookup, arena_map_t<mmap_arena<huge_pages::none>>)->Arg(1 << 18);
+BENCHMARK_TEMPLATE(BM_MapRandomLookup, arena_map_t<mmap_arena<huge_pages::transparent>>)->Arg(1 << 18);
+BENCHMARK_TEMPLATE(BM_MapRandomLookup, arena_map_t<mmap_arena<huge_pages::explicit_tlb>>)->Arg(1 << 18);
+BENCHMARK_TEMPLATE(BM_MapRandomLookup, arena_map_t<mmap_arena<huge_pages::transparent, 0>>)->Arg(1 << 18);
+#endif
+
+struct chase_node_t {
+    chase_node_t* next;
+    long payload[7];
+};
+
+// Pointer chasing through nodes linked in random order, one dependent load per node
+template<typename Arena>
+static void BM_NodeChase(benchmark::State& state) {
+    constexpr size_t n = 1 << 20;
+    std::unique_ptr<custom_allocator<chase_node_t, n, Arena>> alloc(new custom_allocator<chase_node_t, n, Arena>);
+    std::vector<chase_node_t*> nodes(n);
+    for (auto& node: nodes) {
+        node = alloc->allocate(1);
+    }
+    std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1));
+    for (size_t i = 0; i < n; ++i) {
+        nodes[i]->next = nodes[(i + 1) % n];
+        nodes[i]->payload[0] = static_cast<long>(i);
+    }
+    for (auto _: state) {
+        long sum = 0;
+        const chase_node_t* node = nodes[0];
+        for (size_t i = 0; i < n; ++i) {
+            sum += node->payload[0];
+            node = node->next;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    for (auto node: nodes) {
+        alloc->deallocate(node, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_NodeChase, malloc_arena);
+#ifdef __linux__
+BENCHMARK_TEMPLATE(BM_NodeChase, mmap_arena<huge_pages::none>);
+BENCHMARK_TEMPLATE(BM_NodeChase, mmap_arena<huge_pages::transparent>);
+BENCHMARK_TEMPLATE(BM_NodeChase, mmap_arena<huge_pages::transparent, -1, false>);
+#endif
+
+// Lookup in random order and iteration: red-black tree versus flat sorted map, each with the
+// standard allocator and with custom_allocator
+template<size_t N>
+using alloc_flat_map_t = custom_flat_map<int, int, std::less<int>, custom_allocator<std::pair<const int, int>, N>>;
+
+template<typename Map>
+void fill_map(Map& m, int n) {
+    for (int i = 0; i < n; ++i) {
+        m[i] = i;
+    }
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void fill_map(custom_flat_map<Key, Value, Compare, Allocator>& m, int n) {
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < n; ++i) {
+        items.emplace_back(i, i);
+    }
+    m.assign(sorted_unique, items.begin(), items.end());
+}
+
+template<typename Map>
+static void BM_RandomLookup(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    std::unique_ptr<Map> m(new Map);
+    fill_map(*m, n);
+    std::vector<int> keys(n);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+    for (auto _: state) {
+        long sum = 0;
+        for (auto k: keys) {
+            sum += (*m->find(k)).second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_RandomLookup, std::map<int, int>)->Arg(1024)->Arg(8192)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_map_t<8192>)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_map_t<65536>)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_RandomLookup, custom_flat_map<int, int>)->Arg(1024)->Arg(8192)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_flat_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_flat_map_t<8192>)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_RandomLookup, alloc_flat_map_t<65536>)->Arg(65536);
+
+template<typename Map>
+static void BM_Iterate(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    std::unique_ptr<Map> m(new Map);
+    fill_map(*m, n);
+    for (auto _: state) {
+        long sum = 0;
+        for (auto kv: *m) {
+            sum += kv.second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK_TEMPLATE(BM_Iterate, std::map<int, int>)->Arg(1024)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_Iterate, alloc_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_Iterate, alloc_map_t<65536>)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_Iterate, custom_flat_map<int, int>)->Arg(1024)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_Iterate, alloc_flat_map_t<1024>)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_Iterate, alloc_flat_map_t<65536>)->Arg(65536);
+
+BENCHMARK_MAIN();
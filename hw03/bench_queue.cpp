@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "custom_allocator.h"
+#include "custom_queue.h"
+
+
+using steady_clock = std::chrono::steady_clock;
+
+struct item_t {
+    uint64_t seq;
+    int64_t pushed_ns;
+};
+
+constexpr size_t queue_capacity = 1024;
+
+using queue_t = custom_queue<item_t, custom_allocator<item_t, queue_capacity + 1>>;
+
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs n_producers threads pushing ops_per_producer items each into a single consumer,
+// prints throughput and enqueue-to-dequeue latency percentiles.
+bool run(size_t n_producers, size_t ops_per_producer) {
+    queue_t queue(queue_capacity);
+    const size_t total = n_producers * ops_per_producer;
+    std::vector<int64_t> latencies;
+    latencies.reserve(total);
+    uint64_t checksum = 0;
+
+    auto start = steady_clock::now();
+    std::thread consumer([&]() {
+        item_t item{};
+        while (latencies.size() < total) {
+            if (!queue.try_pop(item)) {
+                std::this_thread::yield();
+                continue;
+            }
+            latencies.push_back(now_ns() - item.pushed_ns);
+            checksum += item.seq;
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < n_producers; ++p) {
+        producers.emplace_back([&queue, p, ops_per_producer]() {
+            for (size_t i = 0; i < ops_per_producer; ++i) {
+                item_t item{p * ops_per_producer + i, 0};
+                item.pushed_ns = now_ns();
+                while (!queue.try_push(item)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t: producers) {
+        t.join();
+    }
+    consumer.join();
+    auto elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))];
+    };
+    std::cout << n_producers << "->1"
+              << "\tops/sec: " << uint64_t(total / elapsed)
+              << "\tp50: " << percentile(0.50) << " ns"
+              << "\tp99: " << percentile(0.99) << " ns"
+              << "\tmax: " << latencies.back() << " ns\n";
+
+    // every sequence number 0..total-1 must be received exactly once
+    return checksum == uint64_t(total) * (total - 1) / 2;
+}
+
+
+int main(int argc, char const* argv[])
+{
+    try {
+        size_t ops = argc > 1 ? std::stoul(argv[1]) : 1000000;
+        size_t max_producers = argc > 2 ? std::stoul(argv[2]) :
+                               std::max(3u, std::thread::hardware_concurrency()) - 1;
+        // every producer must push at least one item, otherwise there are no latencies to report
+        if (max_producers == 0 || ops < max_producers) {
+            throw std::invalid_argument("usage: bench_queue [ops >= producers] [producers >= 1]");
+        }
+
+        for (size_t n = 1; n <= max_producers; n *= 2) {
+            if (!run(n, ops / n)) {
+                std::cerr << "custom_queue lost or duplicated items with " << n << " producers\n";
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,7 +3,10 @@
 #include <memory>
 #include <array>
 
-template<typename T, size_t N>
+#include "arena_memory.h"
+
+// Arena is the policy providing backing memory of N elements, see arena_memory.h
+template<typename T, size_t N, typename Arena = malloc_arena>
 class custom_allocator
 {
 public:
@@ -17,27 +20,27 @@ public:
 
     template<typename U>
     struct rebind {
-        using other = custom_allocator<U, N>;
+        using other = custom_allocator<U, N, Arena>;
     };
 
     custom_allocator() = default;
-    custom_allocator(const custom_allocator<T, N>&) noexcept {}
+    custom_allocator(const custom_allocator<T, N, Arena>&) noexcept {}
 
     ~custom_allocator() {
         if (buffer_) {
-            std::free(buffer_);
+            Arena::deallocate(buffer_, N * sizeof(T));
         }
     }
 
-    bool operator == (const custom_allocator<T, N>&) { return false; }
-    bool operator != (const custom_allocator<T, N>&) { return true; }
+    bool operator == (const custom_allocator<T, N, Arena>&) { return false; }
+    bool operator != (const custom_allocator<T, N, Arena>&) { return true; }
 
     pointer allocate(size_t n) {
         if (n == 0) {
             return nullptr;
         }
         if (!buffer_) {
-            buffer_ = reinterpret_cast<T*>(std::malloc(N * sizeof(T)));
+            buffer_ = reinterpret_cast<T*>(Arena::allocate(N * sizeof(T)));
             if (!buffer_) {
                 std::cerr << "custom_allocator failed to allocate memory!\n";
                 throw std::bad_alloc();
@@ -64,8 +67,9 @@ public:
             std::cerr << "custom_allocator failed to deallocate invalid pointer! pointer: " <<  ptr << "\n";
             throw std::bad_alloc();
         }
-        size_t ind = static_cast<size_t>((ptr - buffer_) / sizeof(T));
+        size_t ind = static_cast<size_t>(ptr - buffer_);
         set_used(ind, n, false);
+        first_free_ = std::min(first_free_, ind);
         size_ -= std::min(size_, n);
     }
 
@@ -80,9 +84,10 @@ public:
 
 private:
     pointer find_free_memory(size_t n) {
-        size_t i_cur = 0;
+        // every element before first_free_ is used, so the search does not rescan a filled arena
+        size_t i_cur = first_free_;
         size_t n_cur = 0;
-        for (size_t i = 0; i < N; ++i) {
+        for (size_t i = first_free_; i < N; ++i) {
             if (used_[i]) {
                 i_cur = i + 1;
                 n_cur = 0;
@@ -105,6 +110,9 @@ private:
                          N << " starting index: " << i_cur << " requested size: " << n << "\n";
             throw std::out_of_range("custom_allocator trying to occupy memory out of range!");
         }
+        if (is_used && i_cur == first_free_) {
+            first_free_ = i_end;
+        }
         for (; i_cur < i_end; ++i_cur) {
             used_[i_cur] = is_used;
         }
@@ -122,4 +130,5 @@ private:
     T* buffer_{nullptr};
     bool used_[N] = {};
     size_t size_{0};
+    size_t first_free_{0};
 };
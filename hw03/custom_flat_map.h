@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Search layout shared by custom_flat_map and constexpr_flat_map.
+// Eytzinger layout stores a sorted array in breadth-first order of the implicit binary search tree:
+// children of node k are 2k and 2k + 1 (1-based), so the first levels of every search share the same
+// few cache lines and the next nodes to visit are adjacent in memory.
+namespace flat_map_layout {
+
+    // Fills eyt[k - 1] for k in [1, n] from sorted keys, rank[k - 1] is the position of that key in sorted
+    template<typename Key>
+    constexpr size_t build(const Key* sorted, size_t n, Key* eyt, size_t* rank, size_t i = 0, size_t k = 1) {
+        if (k <= n) {
+            i = build(sorted, n, eyt, rank, i, 2 * k);
+            eyt[k - 1] = sorted[i];
+            rank[k - 1] = i++;
+            i = build(sorted, n, eyt, rank, i, 2 * k + 1);
+        }
+        return i;
+    }
+
+    // Returns 1-based Eytzinger index of the first key not less than key, 0 if all keys are less
+    template<typename Key, typename Compare>
+    constexpr size_t lower_bound(const Key* eyt, size_t n, const Key& key, Compare comp) {
+        size_t k = 1;
+        while (k <= n) {
+            k = 2 * k + (comp(eyt[k - 1], key) ? 1 : 0);
+        }
+        // the answer is the last node where the search turned left: drop trailing right turns and that one
+        while (k & 1) {
+            k >>= 1;
+        }
+        return k >> 1;
+    }
+
+}
+
+
+// Tag of constructors taking input that is already sorted and has no duplicate keys
+struct sorted_unique_t {};
+constexpr sorted_unique_t sorted_unique{};
+
+
+// Sorted map keeping keys and values in contiguous arrays instead of tree nodes.
+// Lookups search a separate Eytzinger copy of the keys, iteration walks the sorted arrays.
+// Built in bulk from a range; insert is O(n) since it rebuilds the layout, so the map suits
+// tables that are filled once and read many times.
+template<typename Key, typename Value, typename Compare = std::less<Key>,
+         typename Allocator = std::allocator<std::pair<const Key, Value>> >
+class custom_flat_map {
+public:
+    using key_allocator_t = typename Allocator::template rebind<Key>::other;
+    using value_allocator_t = typename Allocator::template rebind<Value>::other;
+    using rank_allocator_t = typename Allocator::template rebind<size_t>::other;
+
+    class iterator_t {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::pair<Key, Value>;
+        using pointer = void;
+        using reference = std::pair<const Key&, const Value&>;
+
+        iterator_t(const custom_flat_map* map, size_t i): map_(map), i_(i) {}
+
+        reference operator*() const {
+            return {map_->keys_[i_], map_->values_[i_]};
+        }
+        iterator_t& operator++() {
+            ++i_;
+            return *this;
+        }
+        iterator_t operator++(int) {
+            iterator_t tmp = *this;
+            ++i_;
+            return tmp;
+        }
+        friend bool operator!=(const iterator_t& lhs, const iterator_t& rhs) { return lhs.i_ != rhs.i_; }
+        friend bool operator==(const iterator_t& lhs, const iterator_t& rhs) { return lhs.i_ == rhs.i_; }
+    private:
+        const custom_flat_map* map_;
+        size_t i_;
+    };
+
+    custom_flat_map() = default;
+
+    // Builds map from pairs in any order, for duplicate keys the first value wins
+    template<typename InputIt>
+    custom_flat_map(InputIt first, InputIt last) {
+        assign(first, last);
+    }
+
+    template<typename InputIt>
+    custom_flat_map(sorted_unique_t, InputIt first, InputIt last) {
+        assign(sorted_unique, first, last);
+    }
+
+    custom_flat_map(std::initializer_list<std::pair<Key, Value>> items) {
+        assign(items.begin(), items.end());
+    }
+
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last) {
+        std::vector<std::pair<Key, Value>> items(first, last);
+        std::stable_sort(items.begin(), items.end(), [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) {
+            return comp_(a.first, b.first);
+        });
+        items.erase(std::unique(items.begin(), items.end(), [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) {
+            return !comp_(a.first, b.first) && !comp_(b.first, a.first);
+        }), items.end());
+        assign(sorted_unique, items.begin(), items.end());
+    }
+
+    template<typename InputIt>
+    void assign(sorted_unique_t, InputIt first, InputIt last) {
+        const auto n = static_cast<size_t>(std::distance(first, last));
+        clear();
+        // exact reservations, so a fixed-size custom_allocator arena of n elements is enough
+        keys_.reserve(n);
+        values_.reserve(n);
+        for (; first != last; ++first) {
+            keys_.push_back(first->first);
+            values_.push_back(first->second);
+        }
+        build_layout();
+    }
+
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+
+    iterator_t begin() const { return iterator_t(this, 0); }
+    iterator_t end() const { return iterator_t(this, size()); }
+
+    // Sorted keys and values, contiguous
+    const Key* keys() const { return keys_.data(); }
+    const Value* values() const { return values_.data(); }
+
+    iterator_t lower_bound(const Key& key) const {
+        return iterator_t(this, rank_of(search(key)));
+    }
+
+    iterator_t find(const Key& key) const {
+        size_t i = rank_of(search(key));
+        return i < size() && !comp_(key, keys_[i]) ? iterator_t(this, i) : end();
+    }
+
+    size_t count(const Key& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    const Value& at(const Key& key) const {
+        size_t i = rank_of(search(key));
+        if (i == size() || comp_(key, keys_[i])) {
+            throw std::out_of_range("custom_flat_map::at key not found");
+        }
+        return values_[i];
+    }
+
+    // Inserts or replaces value, O(n)
+    void insert(const Key& key, const Value& value) {
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key, comp_);
+        auto i = it - keys_.begin();
+        if (it != keys_.end() && !comp_(key, *it)) {
+            values_[i] = value;
+            return;
+        }
+        keys_.insert(it, key);
+        values_.insert(values_.begin() + i, value);
+        build_layout();
+    }
+
+    void clear() {
+        keys_.clear();
+        values_.clear();
+        eyt_.clear();
+        rank_.clear();
+    }
+
+private:
+    void build_layout() {
+        eyt_.resize(keys_.size());
+        rank_.resize(keys_.size());
+        flat_map_layout::build(keys_.data(), keys_.size(), eyt_.data(), rank_.data());
+    }
+
+    // Same as flat_map_layout::lower_bound, with the nodes four levels ahead prefetched
+    size_t search(const Key& key) const {
+        const size_t n = eyt_.size();
+        size_t k = 1;
+        while (k <= n) {
+#ifdef __GNUC__
+            // forming a pointer past the end of the array is undefined even if it is never dereferenced
+            if (16 * k < n) {
+                __builtin_prefetch(eyt_.data() + 16 * k);
+            }
+#endif
+            k = 2 * k + (comp_(eyt_[k - 1], key) ? 1 : 0);
+        }
+        while (k & 1) {
+            k >>= 1;
+        }
+        return k >> 1;
+    }
+
+    size_t rank_of(size_t k) const {
+        return k ? rank_[k - 1] : size();
+    }
+
+    std::vector<Key, key_allocator_t> keys_;
+    std::vector<Value, value_allocator_t> values_;
+    std::vector<Key, key_allocator_t> eyt_;
+    std::vector<size_t, rank_allocator_t> rank_;
+    Compare comp_;
+};
+
+
+// Fixed-size flat map that can be built entirely at compile time.
+// Keys and values are sorted by the constructor, so a table produced by a constexpr function
+// can be used in constant expressions:
+//
+//     constexpr int keys[] = {2, 0, 1};
+//     constexpr int values[] = {20, 0, 10};
+//     constexpr constexpr_flat_map<int, int, 3> m(keys, values);
+//     static_assert(m.at(1) == 10, "");
+template<typename Key, typename Value, size_t N, typename Compare = std::less<Key>>
+class constexpr_flat_map {
+public:
+    // Keys must be unique
+    constexpr constexpr_flat_map(const Key (&keys)[N], const Value (&values)[N])
+        : keys_{}, values_{}, eyt_{}, rank_{} {
+        for (size_t i = 0; i < N; ++i) {
+            keys_[i] = keys[i];
+            values_[i] = values[i];
+        }
+        // insertion sort, constexpr-friendly and fine for tables built at compile time
+        for (size_t i = 1; i < N; ++i) {
+            for (size_t j = i; j > 0 && Compare()(keys_[j], keys_[j - 1]); --j) {
+                Key k = keys_[j];
+                keys_[j] = keys_[j - 1];
+                keys_[j - 1] = k;
+                Value v = values_[j];
+                values_[j] = values_[j - 1];
+                values_[j - 1] = v;
+            }
+        }
+        flat_map_layout::build(keys_, N, eyt_, rank_);
+    }
+
+    constexpr size_t size() const { return N; }
+
+    // Sorted keys and values, contiguous
+    constexpr const Key* keys() const { return keys_; }
+    constexpr const Value* values() const { return values_; }
+
+    // Pointer to value or nullptr if key is not found
+    constexpr const Value* find(const Key& key) const {
+        size_t i = index_of(key);
+        return i < N ? &values_[i] : nullptr;
+    }
+
+    constexpr size_t count(const Key& key) const {
+        return index_of(key) < N ? 1 : 0;
+    }
+
+    constexpr const Value& at(const Key& key) const {
+        return index_of(key) < N ? values_[index_of(key)] : throw std::out_of_range("constexpr_flat_map::at key not found");
+    }
+
+private:
+    // Position of key in sorted arrays, N if key is not found
+    constexpr size_t index_of(const Key& key) const {
+        size_t k = flat_map_layout::lower_bound(eyt_, N, key, Compare());
+        return k && !Compare()(key, eyt_[k - 1]) ? rank_[k - 1] : N;
+    }
+
+    Key keys_[N];
+    Value values_[N];
+    Key eyt_[N];
+    size_t rank_[N];
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Lock-free multi-producer single-consumer queue (Vyukov variant of Michael-Scott queue).
+// Nodes follow the custom_list layout (value + next pointer) and are taken from a pool that is
+// allocated once through Allocator, so try_push/try_pop never call malloc. Free nodes are kept
+// in a Treiber stack addressed by index with an ABA tag in the upper 32 bits.
+template<typename T, typename Allocator = std::allocator<T> >
+class custom_queue {
+public:
+    struct node_t {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+        std::atomic<node_t*> next_;
+        std::atomic<uint32_t> free_next_;
+
+        T* value() { return reinterpret_cast<T*>(&storage_); }
+    };
+
+    using allocator_t = typename Allocator::template rebind<node_t>::other;
+
+    // capacity - maximum number of elements stored at once, one extra node is used as a stub
+    explicit custom_queue(size_t capacity): capacity_(capacity + 1) {
+        if (capacity_ > UINT32_MAX - 1) {
+            throw std::length_error("custom_queue capacity is too large");
+        }
+        nodes_ = allocator_.allocate(capacity_);
+        if (!nodes_) {
+            throw std::runtime_error("Failed to allocate memory in custom_queue");
+        }
+        for (size_t i = 0; i < capacity_; ++i) {
+            allocator_.construct(&nodes_[i]);
+            nodes_[i].next_.store(nullptr, std::memory_order_relaxed);
+            // free list is 1-based, 0 terminates it
+            nodes_[i].free_next_.store(i + 1 < capacity_ ? uint32_t(i + 2) : 0, std::memory_order_relaxed);
+        }
+        // first node is the stub, the rest go to the free list
+        head_.store(&nodes_[0], std::memory_order_relaxed);
+        tail_ = &nodes_[0];
+        free_.store(capacity_ > 1 ? 2 : 0, std::memory_order_relaxed);
+    }
+    ~custom_queue() {
+        for (auto cur = tail_->next_.load(std::memory_order_acquire); cur != nullptr;
+             cur = cur->next_.load(std::memory_order_acquire)) {
+            cur->value()->~T();
+        }
+        for (size_t i = 0; i < capacity_; ++i) {
+            allocator_.destroy(&nodes_[i]);
+        }
+        allocator_.deallocate(nodes_, capacity_);
+    }
+    custom_queue(const custom_queue&) = delete;
+    custom_queue& operator=(const custom_queue&) = delete;
+
+    size_t capacity() const { return capacity_ - 1; }
+
+    // Safe to call from any number of threads. Returns false if all nodes are in use.
+    // If the constructor of T throws, the node goes back to the pool and the queue is unchanged.
+    template<typename U>
+    bool try_push(U&& value) {
+        node_t* node = acquire_node();
+        if (!node) {
+            return false;
+        }
+        try {
+            new(node->value()) T(std::forward<U>(value));
+        }
+        catch (...) {
+            release_node(node);
+            throw;
+        }
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        node_t* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next_.store(node, std::memory_order_release);
+        return true;
+    }
+
+    // Must be called from a single consumer thread. Returns false if the queue is empty
+    // (or a producer has not yet linked its node).
+    bool try_pop(T& value) {
+        node_t* tail = tail_;
+        node_t* next = tail->next_.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(*next->value());
+        next->value()->~T();
+        // next becomes the new stub, old stub returns to the pool
+        tail_ = next;
+        release_node(tail);
+        return true;
+    }
+
+    bool empty() const {
+        return !tail_->next_.load(std::memory_order_acquire);
+    }
+
+private:
+    static uint32_t index_of(uint64_t v) { return uint32_t(v); }
+    static uint64_t tagged(uint64_t prev, uint32_t index) { return ((prev >> 32) + 1) << 32 | index; }
+
+    node_t* acquire_node() {
+        uint64_t cur = free_.load(std::memory_order_acquire);
+        while (index_of(cur)) {
+            node_t* node = &nodes_[index_of(cur) - 1];
+            uint32_t next = node->free_next_.load(std::memory_order_relaxed);
+            if (free_.compare_exchange_weak(cur, tagged(cur, next),
+                                            std::memory_order_acquire, std::memory_order_acquire)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    void release_node(node_t* node) {
+        uint32_t index = uint32_t(node - nodes_) + 1;
+        uint64_t cur = free_.load(std::memory_order_relaxed);
+        do {
+            node->free_next_.store(index_of(cur), std::memory_order_relaxed);
+        } while (!free_.compare_exchange_weak(cur, tagged(cur, index),
+                                              std::memory_order_release, std::memory_order_relaxed));
+    }
+
+private:
+    size_t capacity_;
+    node_t* nodes_{nullptr};
+    alignas(64) std::atomic<node_t*> head_{nullptr};
+    alignas(64) node_t* tail_{nullptr};
+    alignas(64) std::atomic<uint64_t> free_{0};
+    allocator_t allocator_;
+};
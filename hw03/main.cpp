@@ -5,6 +5,7 @@
 
 #include "custom_allocator.h"
 #include "custom_container.h"
+#include "custom_flat_map.h"
 
 
 constexpr int fact(const int val) {
@@ -18,6 +19,18 @@ constexpr int fact(const int val) {
     return ret;
 }
 
+// Factorial table of keys 0..N-1, built at compile time
+template<int N>
+constexpr constexpr_flat_map<int, int, N> make_fact_table() {
+    int keys[N] = {};
+    int values[N] = {};
+    for (int i = 0; i < N; ++i) {
+        keys[i] = i;
+        values[i] = fact(i);
+    }
+    return constexpr_flat_map<int, int, N>(keys, values);
+}
+
 
 int main(int, char const* [])
 {       
@@ -45,6 +58,12 @@ int main(int, char const* [])
         }
     }
 
+    {
+        // таблица факториалов в плоском отсортированном контейнере, построенная на этапе компиляции
+        constexpr auto fact_table = make_fact_table<n>();
+        static_assert(fact_table.at(n - 1) == fact(n - 1), "factorial table is built at compile time");
+    }
+
     {
         // создание экземпляра своего контейнера для хранения значений типа int
         custom_list<int> my_list;
@@ -0,0 +1,163 @@
+#include "custom_allocator.h"
+#include "custom_flat_map.h"
+
+#include <functional>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+namespace {
+
+template<typename Compare, typename Allocator = std::allocator<std::pair<const int, int>>>
+struct flat_map_params {
+    using map_t = custom_flat_map<int, int, Compare, Allocator>;
+    using ref_t = std::map<int, int, Compare>;
+};
+
+// arena large enough for vectors growing by insert, which hold the old and the new buffer at once
+using arena_alloc_t = custom_allocator<std::pair<const int, int>, 4096>;
+
+template<typename Params>
+class CustomFlatMap : public testing::Test {};
+
+using flat_map_types = testing::Types<
+    flat_map_params<std::less<int>>,
+    flat_map_params<std::greater<int>>,
+    flat_map_params<std::less<int>, arena_alloc_t>,
+    flat_map_params<std::greater<int>, arena_alloc_t>>;
+TYPED_TEST_CASE(CustomFlatMap, flat_map_types);
+
+// Compares every lookup of m against std::map over keys in [lo, hi]
+template<typename Map, typename Ref>
+void expect_same(const Map& m, const Ref& ref, int lo, int hi) {
+    ASSERT_EQ(m.size(), ref.size());
+    EXPECT_EQ(m.empty(), ref.empty());
+
+    std::vector<std::pair<int, int>> items;
+    for (auto it = m.begin(); it != m.end(); ++it) {
+        items.emplace_back((*it).first, (*it).second);
+    }
+    const std::vector<std::pair<int, int>> ref_items(ref.begin(), ref.end());
+    EXPECT_EQ(items, ref_items);
+    for (size_t i = 0; i < m.size(); ++i) {
+        EXPECT_EQ(m.keys()[i], items[i].first);
+        EXPECT_EQ(m.values()[i], items[i].second);
+    }
+
+    for (int key = lo; key <= hi; ++key) {
+        auto ref_it = ref.find(key);
+        auto it = m.find(key);
+        ASSERT_EQ(it == m.end(), ref_it == ref.end()) << "find " << key;
+        EXPECT_EQ(m.count(key), ref.count(key)) << "count " << key;
+        if (ref_it != ref.end()) {
+            EXPECT_EQ((*it).first, key);
+            EXPECT_EQ((*it).second, ref_it->second);
+            EXPECT_EQ(m.at(key), ref_it->second);
+        }
+        else {
+            EXPECT_THROW(m.at(key), std::out_of_range) << "at " << key;
+        }
+
+        auto ref_lb = ref.lower_bound(key);
+        auto lb = m.lower_bound(key);
+        ASSERT_EQ(lb == m.end(), ref_lb == ref.end()) << "lower_bound " << key;
+        if (ref_lb != ref.end()) {
+            EXPECT_EQ((*lb).first, ref_lb->first) << "lower_bound " << key;
+        }
+    }
+}
+
+}
+
+
+TYPED_TEST(CustomFlatMap, Empty) {
+    typename TypeParam::map_t m;
+    typename TypeParam::ref_t ref;
+    expect_same(m, ref, -2, 2);
+    EXPECT_TRUE(m.begin() == m.end());
+}
+
+
+TYPED_TEST(CustomFlatMap, BuildFromUnsortedWithDuplicates) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> key(-500, 500);
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 300; ++i) {
+        items.emplace_back(key(gen), i);
+    }
+    // sizes around powers of two leave the last Eytzinger level full, partial or with one node
+    for (size_t n: {1, 2, 3, 7, 8, 9, 100, 300}) {
+        typename TypeParam::map_t m(items.begin(), items.begin() + n);
+        typename TypeParam::ref_t ref;
+        for (size_t i = 0; i < n; ++i) {
+            // the first value of a duplicate key wins, as with std::map::insert
+            ref.insert(items[i]);
+        }
+        expect_same(m, ref, -510, 510);
+    }
+}
+
+
+TYPED_TEST(CustomFlatMap, SortedUnique) {
+    typename TypeParam::ref_t ref;
+    for (int i = 0; i < 50; ++i) {
+        ref[3 * i] = i;
+    }
+    typename TypeParam::map_t m(sorted_unique, ref.begin(), ref.end());
+    expect_same(m, ref, -5, 155);
+}
+
+
+TYPED_TEST(CustomFlatMap, Insert) {
+    typename TypeParam::map_t m{{5, 50}, {1, 10}, {9, 90}};
+    typename TypeParam::ref_t ref{{5, 50}, {1, 10}, {9, 90}};
+    expect_same(m, ref, 0, 10);
+
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> key(-100, 100);
+    for (int i = 0; i < 200; ++i) {
+        // insert replaces the value of an existing key
+        const int k = key(gen);
+        m.insert(k, i);
+        ref[k] = i;
+        if (i % 20 == 0) {
+            expect_same(m, ref, -105, 105);
+        }
+    }
+    expect_same(m, ref, -105, 105);
+
+    m.clear();
+    ref.clear();
+    expect_same(m, ref, -1, 1);
+    m.insert(7, 70);
+    ref[7] = 70;
+    expect_same(m, ref, 6, 8);
+}
+
+
+TEST(ConstexprFlatMap, Lookup) {
+    constexpr int keys[] = {40, 10, 30, 20, 0};
+    constexpr int values[] = {4, 1, 3, 2, 0};
+    constexpr constexpr_flat_map<int, int, 5> m(keys, values);
+    static_assert(m.at(30) == 3, "built at compile time");
+    static_assert(m.count(25) == 0, "built at compile time");
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(m.keys()[i], 10 * i);
+        EXPECT_EQ(m.values()[i], i);
+        ASSERT_NE(m.find(10 * i), nullptr);
+        EXPECT_EQ(*m.find(10 * i), i);
+        EXPECT_EQ(m.find(10 * i + 5), nullptr);
+    }
+    EXPECT_THROW(m.at(5), std::out_of_range);
+
+    constexpr constexpr_flat_map<int, int, 5, std::greater<int>> desc(keys, values);
+    EXPECT_EQ(desc.keys()[0], 40);
+    EXPECT_EQ(desc.at(10), 1);
+    EXPECT_EQ(desc.find(15), nullptr);
+}
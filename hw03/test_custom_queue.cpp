@@ -0,0 +1,154 @@
+#include "custom_allocator.h"
+#include "custom_queue.h"
+
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+
+namespace {
+
+// Copying throws for negative values, the node taken for it must go back to the pool
+struct throwing_t {
+    throwing_t(): value(0) {}
+    explicit throwing_t(int v): value(v) {}
+    throwing_t(const throwing_t& other): value(other.value) {
+        if (value < 0) {
+            throw std::runtime_error("throwing_t copy");
+        }
+    }
+    throwing_t& operator=(const throwing_t&) = default;
+    int value;
+};
+
+}
+
+
+TEST(CustomQueue, SingleProducerFifo) {
+    custom_queue<int> queue(16);
+    int value = -1;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(queue.try_push(round * 10 + i));
+        }
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(queue.try_pop(value));
+            EXPECT_EQ(value, round * 10 + i);
+        }
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+
+TEST(CustomQueue, FullAndEmpty) {
+    custom_queue<int, custom_allocator<int, 5>> queue(4);
+    EXPECT_EQ(queue.capacity(), 4u);
+    int value = -1;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_EQ(value, -1);
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.try_push(i));
+    }
+    EXPECT_FALSE(queue.try_push(4));
+    // one pop frees exactly one node
+    ASSERT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(queue.try_push(4));
+    EXPECT_FALSE(queue.try_push(5));
+
+    for (int i = 1; i <= 4; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_TRUE(queue.empty());
+}
+
+
+TEST(CustomQueue, MoveOnly) {
+    custom_queue<std::unique_ptr<int>> queue(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.try_push(std::unique_ptr<int>(new int(i))));
+    }
+    std::unique_ptr<int> value;
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        ASSERT_TRUE(value);
+        EXPECT_EQ(*value, i);
+    }
+    // the two elements left are destroyed with the queue, leaks are reported by sanitizers
+}
+
+
+TEST(CustomQueue, ThrowingConstructorKeepsNode) {
+    custom_queue<throwing_t> queue(2);
+    const throwing_t bad(-1);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_THROW(queue.try_push(bad), std::runtime_error);
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.try_push(throwing_t(1)));
+    EXPECT_TRUE(queue.try_push(throwing_t(2)));
+    EXPECT_FALSE(queue.try_push(throwing_t(3)));
+
+    throwing_t value;
+    ASSERT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(value.value, 1);
+    ASSERT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(value.value, 2);
+}
+
+
+// Build with WITH_TSAN=ON to check the queue for data races
+TEST(CustomQueue, ManyProducersEveryValueOnce) {
+    constexpr int producers = 4;
+    constexpr int per_producer = 20000;
+    custom_queue<int, custom_allocator<int, 65>> queue(64);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < per_producer; ++i) {
+                while (!queue.try_push(p * per_producer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<int> seen(producers * per_producer, 0);
+    std::vector<int> last(producers, -1);
+    // no ASSERT until producers are joined
+    bool valid = true;
+    int value = 0;
+    for (int received = 0; received < producers * per_producer;) {
+        if (!queue.try_pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ++received;
+        if (value < 0 || value >= producers * per_producer) {
+            valid = false;
+            continue;
+        }
+        ++seen[value];
+        // values of one producer keep their order
+        const int p = value / per_producer;
+        valid = valid && value > last[p];
+        last[p] = value;
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    EXPECT_TRUE(valid);
+    EXPECT_FALSE(queue.try_pop(value));
+    for (size_t i = 0; i < seen.size(); ++i) {
+        ASSERT_EQ(seen[i], 1) << "value " << i;
+    }
+}
@@ -0,0 +1,328 @@
+#include "compressed_input.h"
+#include "ip_filter.h"
+#include "ipv6.h"
+#include "pipeline.h"
+#include "sorted_pool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+
+//! Generates pool of random IPv4 addresses, the same for given size
+ipv4_vec make_ip_pool(std::size_t size) {
+    std::mt19937 gen(static_cast<std::mt19937::result_type>(size));
+    std::uniform_int_distribution<int> byte(0, 255);
+    ipv4_vec ip_pool(size);
+    for (auto& a: ip_pool) {
+        a = {byte(gen), byte(gen), byte(gen), byte(gen)};
+    }
+    return ip_pool;
+}
+
+//! Generates lines in the format of ip_filter.tsv for the same random pool
+std::vector<std::string> make_tsv_lines(std::size_t size) {
+    std::vector<std::string> lines;
+    lines.reserve(size);
+    for (const auto& a: make_ip_pool(size)) {
+        std::ostringstream os;
+        os << a[0] << '.' << a[1] << '.' << a[2] << '.' << a[3] << '\t' << a[3] * 7 << '\t' << a[2] % 3;
+        lines.push_back(os.str());
+    }
+    return lines;
+}
+
+
+static void BM_Split(benchmark::State& state) {
+    auto lines = make_tsv_lines(state.range(0));
+    for (auto _: state) {
+        for (const auto& line: lines) {
+            auto v = split(line, '\t');
+            benchmark::DoNotOptimize(split(v.at(0), '.'));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_Split)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+
+static void BM_Sort(benchmark::State& state) {
+    auto ip_pool = make_ip_pool(state.range(0));
+    for (auto _: state) {
+        state.PauseTiming();
+        auto pool = ip_pool;
+        state.ResumeTiming();
+        sort(pool, false);
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_Sort)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_FilterFirstByte(benchmark::State& state) {
+    auto ip_pool = make_ip_pool(state.range(0));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(filter(ip_pool, {1,0,0,0}, 1));
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_FilterFirstByte)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_FilterAnyByte(benchmark::State& state) {
+    auto ip_pool = make_ip_pool(state.range(0));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(filter(ip_pool, {1,1,1,1}, 46));
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_FilterAnyByte)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_Filter2(benchmark::State& state) {
+    auto ip_pool = make_ip_pool(state.range(0));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(filter2(ip_pool, {1,1,1,1}, {46, 70}));
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_Filter2)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_FilterPositions(benchmark::State& state) {
+    auto ip_pool = make_ip_pool(state.range(0));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(filter_positions(ip_pool, {46,70,-1,-1}));
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_FilterPositions)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+// Applying 1% updates (inserts and removals) to a sorted pool versus re-sorting it from scratch.
+// Sizes stop at 4M addresses to fit CI machines, a 100M pool needs ~1.6 GB per copy.
+static void BM_SortedPoolUpdate(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto ip_pool = make_ip_pool(n + n / 100);
+    ipv4_vec batch(ip_pool.begin() + n, ip_pool.end());
+    ipv4_vec removed(ip_pool.begin(), ip_pool.begin() + n / 100);
+    ip_pool.resize(n);
+    for (auto _: state) {
+        state.PauseTiming();
+        sorted_pool_t pool(ip_pool, false);
+        state.ResumeTiming();
+        pool.insert(batch);
+        pool.remove(removed);
+        benchmark::DoNotOptimize(pool.pool().data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SortedPoolUpdate)->RangeMultiplier(8)->Range(1 << 13, 1 << 22)->Unit(benchmark::kMillisecond);
+
+static void BM_ResortUpdate(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto ip_pool = make_ip_pool(n + n / 100);
+    ipv4_vec batch(ip_pool.begin() + n, ip_pool.end());
+    ip_pool.resize(n);
+    sort(ip_pool, false);
+    for (auto _: state) {
+        state.PauseTiming();
+        auto pool = ip_pool;
+        state.ResumeTiming();
+        pool.erase(pool.begin(), pool.begin() + n / 100);
+        pool.insert(pool.end(), batch.begin(), batch.end());
+        sort(pool, false);
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ResortUpdate)->RangeMultiplier(8)->Range(1 << 13, 1 << 22)->Unit(benchmark::kMillisecond);
+
+// End-to-end throughput and time to first output of the pipelined mode versus phased main:
+// parse everything, sort, then filter and print
+std::string make_tsv_file(std::size_t size) {
+    std::string path = "bench_ip_filter_" + std::to_string(size) + ".tsv";
+    std::ofstream os(path);
+    for (const auto& line: make_tsv_lines(size)) {
+        os << line << '\n';
+    }
+    return path;
+}
+
+static void BM_PipelineFile(benchmark::State& state) {
+    auto path = make_tsv_file(state.range(0));
+    std::FILE* out = std::fopen("/dev/null", "w");
+    double first_output_ms = 0;
+    for (auto _: state) {
+        std::FILE* in = std::fopen(path.c_str(), "r");
+        pipeline_stats_t stats;
+        run_pipeline(fileno(in), out, parse_pipeline_filter("46.-1.-1.-1"), &stats);
+        std::fclose(in);
+        first_output_ms += stats.first_output_ns * 1e-6;
+    }
+    std::fclose(out);
+    std::remove(path.c_str());
+    state.counters["first_output_ms"] = first_output_ms / state.iterations();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PipelineFile)->RangeMultiplier(8)->Range(1 << 16, 1 << 22)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_PhasedFile(benchmark::State& state) {
+    auto path = make_tsv_file(state.range(0));
+    std::FILE* out = std::fopen("/dev/null", "w");
+    double first_output_ms = 0;
+    for (auto _: state) {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(path);
+        ipv4_vec ip_pool;
+        for (std::string line; std::getline(in, line);) {
+            auto ip_str_vec = split(split(line, '\t').at(0), '.');
+            ipv4_t ip_vec;
+            std::transform(ip_str_vec.begin(), ip_str_vec.end(), std::begin(ip_vec),
+                           [](const std::string& str) { return std::stoi(str); });
+            ip_pool.push_back(ip_vec);
+        }
+        sort(ip_pool, false);
+        auto filtered = filter_positions(ip_pool, {46,-1,-1,-1});
+        // nothing can be printed before input is parsed, sorted and filtered
+        first_output_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        for (const auto& a: filtered) {
+            std::fprintf(out, "%d.%d.%d.%d\n", a[0], a[1], a[2], a[3]);
+        }
+        std::fflush(out);
+    }
+    std::fclose(out);
+    std::remove(path.c_str());
+    state.counters["first_output_ms"] = first_output_ms / state.iterations();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PhasedFile)->RangeMultiplier(8)->Range(1 << 16, 1 << 22)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+#ifdef IP_FILTER_WITH_ZLIB
+// Pipelined filtering of compressed input: BGZF members decoded on N threads versus sequential gzip
+// decoding, which is what `zcat | ip_filter` does on a single core
+static void BM_PipelineCompressed(benchmark::State& state) {
+    const bool bgzf = state.range(0) != 0;
+    const auto threads = static_cast<unsigned>(state.range(1));
+    std::string text;
+    for (const auto& line: make_tsv_lines(1 << 20)) {
+        text += line;
+        text += '\n';
+    }
+    std::string compressed;
+    if (bgzf) {
+        compressed = bgzf_compress(text.data(), text.size());
+    }
+    else {
+        // a single gzip member, no frame boundaries to decode in parallel
+        uLongf size = compressBound(static_cast<uLong>(text.size())) + 32;
+        compressed.resize(size);
+        z_stream zs{};
+        deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        zs.next_in = reinterpret_cast<Bytef*>(&text[0]);
+        zs.avail_in = static_cast<uInt>(text.size());
+        zs.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+        zs.avail_out = static_cast<uInt>(compressed.size());
+        deflate(&zs, Z_FINISH);
+        compressed.resize(zs.total_out);
+        deflateEnd(&zs);
+    }
+    std::string path = "bench_ip_filter_compressed.gz";
+    {
+        std::ofstream os(path, std::ios::binary);
+        os << compressed;
+    }
+
+    std::FILE* out = std::fopen("/dev/null", "w");
+    for (auto _: state) {
+        std::FILE* in = std::fopen(path.c_str(), "rb");
+        input_reader_t input(fileno(in), threads);
+        run_pipeline(input, out, parse_pipeline_filter("46.-1.-1.-1"));
+        std::fclose(in);
+    }
+    std::fclose(out);
+    std::remove(path.c_str());
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_PipelineCompressed)->ArgNames({"bgzf", "threads"})
+    ->Args({0, 1})->Args({1, 1})->Args({1, 2})->Args({1, 4})->Args({1, 8})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+
+// IPv6 path versus IPv4 path: parsing text into keys and sorting pools of the same size
+std::string make_ip_text(std::size_t size, int ipv6_percent) {
+    std::mt19937_64 gen(size);
+    std::string text;
+    const auto ipv4_lines = make_tsv_lines(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (static_cast<int>(gen() % 100) < ipv6_percent) {
+            // a few /32 networks, as in real traffic
+            ipv6_t a{0x20010db800000000ull + ((gen() % 4) << 32) + (gen() & 0xffffffff), gen()};
+            text += format_ipv6(a) + "\t1\t0\n";
+        }
+        else {
+            text += ipv4_lines[i] + '\n';
+        }
+    }
+    return text;
+}
+
+static void BM_ParseIPv4Lines(benchmark::State& state) {
+    const auto text = make_ip_text(state.range(0), 0);
+    for (auto _: state) {
+        ipv4_vec pool;
+        parse_ip_lines(text.data(), text.data() + text.size(), pool);
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ParseIPv4Lines)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+// Args: pool size, percentage of IPv6 lines, the rest are IPv4 parsed into IPv4-mapped keys
+static void BM_ParseIPv6Lines(benchmark::State& state) {
+    const auto text = make_ip_text(state.range(0), static_cast<int>(state.range(1)));
+    for (auto _: state) {
+        ipv6_vec pool;
+        parse_ip_lines(text.data(), text.data() + text.size(), pool);
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_ParseIPv6Lines)->ArgNames({"size", "ipv6_percent"})
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 19, 8), {0, 50, 100}});
+
+ipv6_vec make_ipv6_pool(std::size_t size) {
+    const auto text = make_ip_text(size, 100);
+    ipv6_vec pool;
+    parse_ip_lines(text.data(), text.data() + text.size(), pool);
+    return pool;
+}
+
+static void BM_SortIPv6(benchmark::State& state) {
+    const auto ip_pool = make_ipv6_pool(state.range(0));
+    for (auto _: state) {
+        state.PauseTiming();
+        auto pool = ip_pool;
+        state.ResumeTiming();
+        sort(pool, false);
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_SortIPv6)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+static void BM_StdSortIPv6(benchmark::State& state) {
+    const auto ip_pool = make_ipv6_pool(state.range(0));
+    for (auto _: state) {
+        state.PauseTiming();
+        auto pool = ip_pool;
+        state.ResumeTiming();
+        std::sort(pool.begin(), pool.end(), std::greater<ipv6_t>());
+        benchmark::DoNotOptimize(pool.data());
+    }
+    state.SetItemsProcessed(state.iterations() * ip_pool.size());
+}
+BENCHMARK(BM_StdSortIPv6)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,433 @@
+#ifndef IP_FILTER_COMPRESSED_INPUT_H
+#define IP_FILTER_COMPRESSED_INPUT_H
+
+#include "pipeline.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef IP_FILTER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef IP_FILTER_WITH_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
+//! Format of input detected by its first bytes
+enum class input_format_t {
+    plain,
+    gzip,   //!< gzip stream without block index, decoded sequentially
+    bgzf,   //!< blocked gzip (bgzip, seekable), members decoded in parallel
+    zstd,   //!< zstd frames decoded in parallel
+};
+
+//! Detects input format by magic bytes at the beginning of data
+inline input_format_t detect_input_format(const char* data, std::size_t size) {
+    const auto* p = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) {
+        return input_format_t::zstd;
+    }
+    if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        // FEXTRA with BC subfield holding the member size
+        if (size >= 16 && (p[3] & 4) && p[12] == 'B' && p[13] == 'C') {
+            return input_format_t::bgzf;
+        }
+        return input_format_t::gzip;
+    }
+    return input_format_t::plain;
+}
+
+//! Size of the compressed frame at the beginning of data, 0 if data does not hold a complete frame
+/*!
+ * Throws std::runtime_error if data is not a valid frame of given format.
+*/
+inline std::size_t compressed_frame_size(input_format_t format, const char* data, std::size_t size) {
+    const auto* p = reinterpret_cast<const unsigned char*>(data);
+    if (format == input_format_t::bgzf) {
+        if (size < 18) {
+            return 0;
+        }
+        if (p[0] != 0x1f || p[1] != 0x8b || !(p[3] & 4) || p[12] != 'B' || p[13] != 'C') {
+            throw std::runtime_error("invalid BGZF block header");
+        }
+        std::size_t bsize = (std::size_t(p[16]) | std::size_t(p[17]) << 8) + 1;
+        return bsize <= size ? bsize : 0;
+    }
+#ifdef IP_FILTER_WITH_ZSTD
+    if (format == input_format_t::zstd) {
+        std::size_t n = ZSTD_findFrameCompressedSize(data, size);
+        if (ZSTD_isError(n)) {
+            // incomplete frame is reported as srcSize_wrong
+            if (ZSTD_getErrorCode(n) == ZSTD_error_srcSize_wrong) {
+                return 0;
+            }
+            throw std::runtime_error(std::string("invalid zstd frame: ") + ZSTD_getErrorName(n));
+        }
+        return n;
+    }
+#endif
+    throw std::runtime_error("unsupported compressed input format");
+}
+
+//! Decodes a job of complete frames into a new buffer
+inline std::vector<char> decode_frames(input_format_t format, const std::vector<char>& src) {
+    std::vector<char> out;
+#ifdef IP_FILTER_WITH_ZLIB
+    if (format == input_format_t::bgzf) {
+        // ISIZE of each member gives exact output size
+        std::size_t total = 0;
+        for (std::size_t pos = 0; pos < src.size();) {
+            std::size_t n = compressed_frame_size(format, src.data() + pos, src.size() - pos);
+            const auto* isize = reinterpret_cast<const unsigned char*>(src.data() + pos + n - 4);
+            total += uint32_t(isize[0]) | uint32_t(isize[1]) << 8 | uint32_t(isize[2]) << 16 | uint32_t(isize[3]) << 24;
+            pos += n;
+        }
+        out.resize(total);
+        z_stream zs{};
+        if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+            throw std::runtime_error("inflateInit2 failed");
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(src.data()));
+        zs.avail_in = static_cast<uInt>(src.size());
+        // members with ISIZE 0, such as the bgzip EOF marker, may make up the whole job, and inflate
+        // rejects a null output buffer even when there is nothing to write
+        Bytef empty = 0;
+        zs.next_out = out.empty() ? &empty : reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        while (zs.avail_in) {
+            int ret = inflate(&zs, Z_FINISH);
+            if (ret != Z_STREAM_END) {
+                inflateEnd(&zs);
+                throw std::runtime_error("corrupted BGZF block");
+            }
+            inflateReset(&zs);
+        }
+        inflateEnd(&zs);
+        return out;
+    }
+#endif
+#ifdef IP_FILTER_WITH_ZSTD
+    if (format == input_format_t::zstd) {
+        ZSTD_DCtx* dctx = ZSTD_createDCtx();
+        ZSTD_inBuffer in{src.data(), src.size(), 0};
+        out.resize(std::max<std::size_t>(src.size() * 4, ZSTD_DStreamOutSize()));
+        std::size_t produced = 0;
+        while (in.pos < in.size) {
+            if (produced == out.size()) {
+                out.resize(out.size() * 2);
+            }
+            ZSTD_outBuffer o{out.data() + produced, out.size() - produced, 0};
+            std::size_t ret = ZSTD_decompressStream(dctx, &o, &in);
+            produced += o.pos;
+            if (ZSTD_isError(ret)) {
+                ZSTD_freeDCtx(dctx);
+                throw std::runtime_error(std::string("zstd decode failed: ") + ZSTD_getErrorName(ret));
+            }
+        }
+        ZSTD_freeDCtx(dctx);
+        out.resize(produced);
+        return out;
+    }
+#endif
+    (void)format;
+    (void)src;
+    throw std::runtime_error("unsupported compressed input format");
+}
+
+//! Reader of plain or compressed input with the interface of block_reader_t
+/*!
+ * Format is detected by the first bytes of input. zstd frames and BGZF members are independent, so
+ * they are grouped into jobs of about job_size compressed bytes, up to `threads` jobs are decoded
+ * concurrently by a fixed pool of `threads` workers started with the first job, and decoded buffers
+ * are handed to the caller in input order without copying. Plain
+ * gzip has no frame index and is decoded sequentially. Input that ends inside a frame or member
+ * throws std::runtime_error.
+*/
+class input_reader_t {
+public:
+    static constexpr std::size_t job_size = 1 << 20;
+
+    explicit input_reader_t(int fd, unsigned threads = std::thread::hardware_concurrency())
+        : input_(fd), threads_(std::max(1u, threads)), pending_(threads_) {
+        while (comp_.size() < 18 && read_more()) {}
+        format_ = detect_input_format(comp_.data(), comp_.size());
+#ifdef IP_FILTER_WITH_ZLIB
+        if (format_ == input_format_t::gzip) {
+            // 32 - detect gzip header, members are concatenated by resetting the stream
+            if (inflateInit2(&zs_, 15 + 32) != Z_OK) {
+                throw std::runtime_error("inflateInit2 failed");
+            }
+            zs_init_ = true;
+        }
+#else
+        if (format_ == input_format_t::gzip || format_ == input_format_t::bgzf) {
+            throw std::runtime_error("gzip input is not supported by this build");
+        }
+#endif
+#ifndef IP_FILTER_WITH_ZSTD
+        if (format_ == input_format_t::zstd) {
+            throw std::runtime_error("zstd input is not supported by this build");
+        }
+#endif
+    }
+    ~input_reader_t() {
+        // workers finish jobs already queued and exit
+        pending_.close();
+        for (auto& t: workers_) {
+            t.join();
+        }
+#ifdef IP_FILTER_WITH_ZLIB
+        if (zs_init_) {
+            inflateEnd(&zs_);
+        }
+#endif
+    }
+    input_reader_t(const input_reader_t&) = delete;
+    input_reader_t& operator=(const input_reader_t&) = delete;
+
+    input_format_t format() const {
+        return format_;
+    }
+
+    //! Reads next block of decoded input into buf, returns number of bytes, 0 at end of input
+    std::size_t next(std::vector<char>& buf) {
+        switch (format_) {
+            case input_format_t::plain:
+                return next_plain(buf);
+            case input_format_t::gzip:
+                return next_gzip(buf);
+            default:
+                return next_parallel(buf);
+        }
+    }
+
+private:
+    bool read_more() {
+        if (eof_) {
+            return false;
+        }
+        std::size_t n = input_.next(chunk_);
+        if (!n) {
+            eof_ = true;
+            return false;
+        }
+        if (pos_ && pos_ >= comp_.size() / 2) {
+            comp_.erase(comp_.begin(), comp_.begin() + static_cast<std::ptrdiff_t>(pos_));
+            pos_ = 0;
+        }
+        comp_.insert(comp_.end(), chunk_.begin(), chunk_.begin() + static_cast<std::ptrdiff_t>(n));
+        return true;
+    }
+
+    std::size_t next_plain(std::vector<char>& buf) {
+        // bytes read while detecting format go first
+        if (pos_ < comp_.size()) {
+            buf.assign(comp_.begin() + static_cast<std::ptrdiff_t>(pos_), comp_.end());
+            pos_ = comp_.size();
+            return buf.size();
+        }
+        return eof_ ? 0 : input_.next(buf);
+    }
+
+    std::size_t next_gzip(std::vector<char>& buf) {
+#ifdef IP_FILTER_WITH_ZLIB
+        buf.resize(block_reader_t::block_size);
+        zs_.next_out = reinterpret_cast<Bytef*>(buf.data());
+        zs_.avail_out = static_cast<uInt>(buf.size());
+        while (zs_.avail_out) {
+            if (pos_ == comp_.size() && !read_more()) {
+                if (member_open_) {
+                    throw std::runtime_error("truncated gzip input");
+                }
+                break;
+            }
+            zs_.next_in = reinterpret_cast<Bytef*>(comp_.data() + pos_);
+            zs_.avail_in = static_cast<uInt>(comp_.size() - pos_);
+            member_open_ = true;
+            int ret = inflate(&zs_, Z_NO_FLUSH);
+            pos_ = comp_.size() - zs_.avail_in;
+            if (ret == Z_STREAM_END) {
+                member_open_ = false;
+                inflateReset(&zs_);
+            }
+            else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                throw std::runtime_error(std::string("corrupted gzip input: ") + (zs_.msg ? zs_.msg : ""));
+            }
+        }
+        return buf.size() - zs_.avail_out;
+#else
+        (void)buf;
+        return 0;
+#endif
+    }
+
+    //! Group of frames decoded by a worker
+    struct job_t {
+        std::vector<char> src;
+        std::vector<char> out;
+        std::exception_ptr error;
+        bool done{false};  //!< guarded by done_m_
+    };
+
+    std::size_t next_parallel(std::vector<char>& buf) {
+        while (jobs_.size() < threads_) {
+            auto job = std::make_shared<job_t>();
+            if (!take_job(job->src)) {
+                break;
+            }
+            if (workers_.size() < threads_) {
+                workers_.emplace_back([this]() { decode_jobs(); });
+            }
+            // never blocks, at most threads_ jobs are in flight
+            pending_.push(job);
+            jobs_.push_back(std::move(job));
+        }
+        while (!jobs_.empty()) {
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            {
+                std::unique_lock<std::mutex> lock(done_m_);
+                done_cv_.wait(lock, [&job]() { return job->done; });
+            }
+            if (job->error) {
+                std::rethrow_exception(job->error);
+            }
+            if (!job->out.empty()) {
+                buf.swap(job->out);
+                return buf.size();
+            }
+        }
+        return 0;
+    }
+
+    //! Worker loop, decodes jobs until pending_ is closed
+    void decode_jobs() {
+        std::shared_ptr<job_t> job;
+        while (pending_.pop(job)) {
+            try {
+                job->out = decode_frames(format_, job->src);
+            }
+            catch (...) {
+                job->error = std::current_exception();
+            }
+            std::vector<char>().swap(job->src);
+            {
+                std::lock_guard<std::mutex> lock(done_m_);
+                job->done = true;
+            }
+            done_cv_.notify_all();
+            job.reset();
+        }
+    }
+
+    //! Cuts next group of complete frames from compressed input
+    bool take_job(std::vector<char>& job) {
+        std::size_t end = pos_;
+        for (;;) {
+            std::size_t n = compressed_frame_size(format_, comp_.data() + end, comp_.size() - end);
+            if (n) {
+                end += n;
+                if (end - pos_ >= job_size) {
+                    break;
+                }
+                continue;
+            }
+            // end - pos_ is kept across read_more, which may move pos_ to 0
+            std::size_t taken = end - pos_;
+            if (!read_more()) {
+                if (end != comp_.size()) {
+                    throw std::runtime_error("truncated compressed input");
+                }
+                break;
+            }
+            end = pos_ + taken;
+        }
+        if (end == pos_) {
+            return false;
+        }
+        job.assign(comp_.begin() + static_cast<std::ptrdiff_t>(pos_), comp_.begin() + static_cast<std::ptrdiff_t>(end));
+        pos_ = end;
+        return true;
+    }
+
+    block_reader_t input_;
+    unsigned threads_;
+    input_format_t format_{input_format_t::plain};
+    std::vector<char> comp_;
+    std::vector<char> chunk_;
+    std::size_t pos_{0};
+    bool eof_{false};
+    std::deque<std::shared_ptr<job_t>> jobs_;          //!< jobs in input order, front is handed out next
+    bounded_queue_t<std::shared_ptr<job_t>> pending_;  //!< jobs waiting for a worker
+    std::vector<std::thread> workers_;
+    std::mutex done_m_;
+    std::condition_variable done_cv_;
+#ifdef IP_FILTER_WITH_ZLIB
+    z_stream zs_{};
+    bool zs_init_{false};
+    bool member_open_{false};  //!< gzip member started but its end is not reached yet
+#endif
+};
+
+#ifdef IP_FILTER_WITH_ZLIB
+//! Empty BGZF member that bgzip writes at the end of every file, htslib treats input without it as truncated
+inline std::string bgzf_eof_block() {
+    return std::string("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00"
+                       "\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00", 28);
+}
+
+//! Compresses data into BGZF blocks, used to prepare parallel decodable input
+/*!
+ * Each block is an independent gzip member of at most 64 KiB holding its compressed size in the BC
+ * extra subfield, as written by bgzip. The end of file marker is not appended, see bgzf_eof_block.
+*/
+inline std::string bgzf_compress(const char* data, std::size_t size, int level = Z_DEFAULT_COMPRESSION) {
+    constexpr std::size_t max_input = 0xff00;
+    std::string out;
+    std::vector<unsigned char> block(0x10000);
+    for (std::size_t pos = 0; pos < size;) {
+        std::size_t n = std::min(max_input, size - pos);
+        z_stream zs{};
+        if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("deflateInit2 failed");
+        }
+        const unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0};
+        std::memcpy(block.data(), header, sizeof(header));
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + pos));
+        zs.avail_in = static_cast<uInt>(n);
+        zs.next_out = block.data() + sizeof(header);
+        // BSIZE is 16 bit, the whole member must fit into 64 KiB
+        zs.avail_out = static_cast<uInt>(0x10000 - sizeof(header) - 8);
+        int ret = deflate(&zs, Z_FINISH);
+        std::size_t clen = zs.total_out;
+        deflateEnd(&zs);
+        if (ret != Z_STREAM_END) {
+            throw std::runtime_error("BGZF block does not fit");
+        }
+        std::size_t bsize = sizeof(header) + clen + 8;
+        block[16] = static_cast<unsigned char>((bsize - 1) & 0xff);
+        block[17] = static_cast<unsigned char>((bsize - 1) >> 8);
+        uint32_t crc = static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(data + pos), static_cast<uInt>(n)));
+        unsigned char* trailer = block.data() + sizeof(header) + clen;
+        for (int i = 0; i < 4; ++i) {
+            trailer[i] = static_cast<unsigned char>(crc >> (8 * i));
+            trailer[4 + i] = static_cast<unsigned char>(uint32_t(n) >> (8 * i));
+        }
+        out.append(reinterpret_cast<const char*>(block.data()), bsize);
+        pos += n;
+    }
+    return out;
+}
+#endif
+
+#endif //IP_FILTER_COMPRESSED_INPUT_H
@@ -1,28 +1,176 @@
+#include "compressed_input.h"
 #include "ip_filter.h"
+#include "ipv6.h"
+#include "pipeline.h"
+#include "query_server.h"
+#include "trace.h"
 
+#include <csignal>
+
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
 
+namespace {
+    std::atomic<bool> serve_stop{false};
+
+    void on_stop_signal(int) {
+        serve_stop = true;
+    }
+}
+
+//! Prints given pool of IPv4 addresses accounting it to the current trace phase
+void print_ip_pool(trace_t& trace, const char* name, const ipv4_vec& ip_pool) {
+    auto phase = trace.phase(name);
+    print_ip_pool(ip_pool);
+    phase.add(ip_pool.size());
+}
+
 int main(int argc, char const *argv[])
 {
+    // --trace          print per-phase timings to stderr
+    // --trace-hw       additionally collect hardware counters (cycles, cache and branch misses)
+    // --trace-file F   write phases to F in Chrome trace format
+    // --pipeline F     stream addresses matching filter F (46.70.-1.-1 or any:46) in input order,
+    //                  gzip, BGZF and zstd compressed input is decoded on the fly
+    // --serve S F      load pool from F once and answer queries on Unix socket S until SIGINT/SIGTERM
+    // --ipv6 F         read IPv4 and IPv6 input in one pass and print addresses matching F in descending
+    //                  order, F is a prefix (2001:db8::/32) or a nibble mask (2001:db8:*:*:*:*:*:1),
+    //                  IPv4 addresses are matched as ::ffff:a.b.c.d
+    bool trace_summary = false;
+    bool trace_hw = false;
+    std::string trace_file;
+    std::string pipeline;
+    std::string serve_socket;
+    std::string serve_pool;
+    std::string ipv6;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--trace") {
+            trace_summary = true;
+        }
+        else if (arg == "--trace-hw") {
+            trace_summary = trace_hw = true;
+        }
+        else if (arg == "--trace-file" && i + 1 < argc) {
+            trace_file = argv[++i];
+        }
+        else if (arg == "--pipeline" && i + 1 < argc) {
+            pipeline = argv[++i];
+        }
+        else if (arg == "--serve" && i + 2 < argc) {
+            serve_socket = argv[++i];
+            serve_pool = argv[++i];
+        }
+        else if (arg == "--ipv6" && i + 1 < argc) {
+            ipv6 = argv[++i];
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--trace] [--trace-hw] [--trace-file FILE] [--pipeline FILTER]"
+                      << " [--serve SOCKET POOL_FILE] [--ipv6 FILTER] < ip_filter.tsv\n";
+            return 1;
+        }
+    }
+
+    // pipeline stages overlap, so there are no phases for trace_t; only --trace prints pipeline stats
+    if (!pipeline.empty() && (trace_hw || !trace_file.empty())) {
+        std::cerr << "--trace-hw and --trace-file are not supported with --pipeline, use --trace\n";
+        return 1;
+    }
+
+    if (!serve_socket.empty()) {
+        try
+        {
+            query_server_t server(serve_socket, serve_pool);
+            std::signal(SIGINT, on_stop_signal);
+            std::signal(SIGTERM, on_stop_signal);
+            std::cerr << "serving " << server.snapshot()->pool().size() << " addresses on " << serve_socket << "\n";
+            server.run(serve_stop);
+        }
+        catch(const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!ipv6.empty()) {
+        try
+        {
+            auto f = parse_ipv6_filter(ipv6);
+            input_reader_t input(STDIN_FILENO);
+            auto ip_pool = read_ip_pool<ipv6_vec>(input);
+            sort(ip_pool, false);
+            print_ip_pool(filter(ip_pool, f));
+        }
+        catch(const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!pipeline.empty()) {
+        try
+        {
+            pipeline_stats_t stats;
+            input_reader_t input(STDIN_FILENO);
+            run_pipeline(input, stdout, parse_pipeline_filter(pipeline), &stats);
+            if (trace_summary) {
+                std::cerr << "records: " << stats.records << " matches: " << stats.matches
+                          << " total: " << stats.total_ns * 1e-6 << " ms"
+                          << " first output: ";
+                if (stats.first_output_ns >= 0) {
+                    std::cerr << stats.first_output_ns * 1e-6 << " ms";
+                }
+                else {
+                    std::cerr << "none";
+                }
+                if (stats.total_ns > 0) {
+                    const double sec = stats.total_ns * 1e-9;
+                    std::cerr << " records/s: " << uint64_t(stats.records / sec)
+                              << " decoded MB/s: " << stats.bytes / sec / 1e6;
+                }
+                std::cerr << "\n";
+            }
+        }
+        catch(const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    trace_t trace(trace_summary || !trace_file.empty(), trace_hw);
+
     try
     {
         ipv4_vec ip_pool;
 
-        for(std::string line; std::getline(std::cin, line);)
         {
-            std::vector<std::string> v = split(line, '\t');
-            auto ip_str_vec = split(v.at(0), '.');
-            ipv4_t ip_vec;
-            std::transform(ip_str_vec.begin(), ip_str_vec.end(), std::begin(ip_vec),
-                           [](const std::string& str) {return std::stoi(str); } );
-            ip_pool.push_back(ip_vec);
+            auto phase = trace.phase("parse");
+            for(std::string line; std::getline(std::cin, line);)
+            {
+                std::vector<std::string> v = split(line, '\t');
+                auto ip_str_vec = split(v.at(0), '.');
+                ipv4_t ip_vec;
+                std::transform(ip_str_vec.begin(), ip_str_vec.end(), std::begin(ip_vec),
+                               [](const std::string& str) {return std::stoi(str); } );
+                ip_pool.push_back(ip_vec);
+                phase.add(1, line.size() + 1);
+            }
         }
 
-        sort(ip_pool, false);
-        print_ip_pool(ip_pool);
+        {
+            auto phase = trace.phase("sort");
+            sort(ip_pool, false);
+            phase.add(ip_pool.size());
+        }
+        print_ip_pool(trace, "print", ip_pool);
         // 222.173.235.246
         // 222.130.177.64
         // 222.82.198.61
@@ -33,7 +181,13 @@ int main(int argc, char const *argv[])
 
         // Filter by first byte and output
         // ip = filter(1)
-        print_ip_pool(filter(ip_pool, {1,0,0,0}, 1));
+        ipv4_vec filtered;
+        {
+            auto phase = trace.phase("filter");
+            filtered = filter(ip_pool, {1,0,0,0}, 1);
+            phase.add(ip_pool.size());
+        }
+        print_ip_pool(trace, "print filter", filtered);
         // 1.231.69.33
         // 1.87.203.225
         // 1.70.44.170
@@ -42,7 +196,12 @@ int main(int argc, char const *argv[])
 
         // Filter by first and second bytes and output
         // ip = filter(46, 70)
-        print_ip_pool(filter_positions(ip_pool, {46,70,-1,-1}));
+        {
+            auto phase = trace.phase("filter_positions");
+            filtered = filter_positions(ip_pool, {46,70,-1,-1});
+            phase.add(ip_pool.size());
+        }
+        print_ip_pool(trace, "print filter_positions", filtered);
         // 46.70.225.39
         // 46.70.147.26
         // 46.70.113.73
@@ -50,7 +209,12 @@ int main(int argc, char const *argv[])
 
         // Filter by any byte and output
         // ip = filter_any(46)
-        print_ip_pool(filter(ip_pool, {1,1,1,1}, 46));
+        {
+            auto phase = trace.phase("filter_any");
+            filtered = filter(ip_pool, {1,1,1,1}, 46);
+            phase.add(ip_pool.size());
+        }
+        print_ip_pool(trace, "print filter_any", filtered);
         // 186.204.34.46
         // 186.46.222.194
         // 185.46.87.231
@@ -91,5 +255,13 @@ int main(int argc, char const *argv[])
         std::cerr << e.what() << std::endl;
     }
 
+    if (trace_summary) {
+        trace.print_summary(std::cerr);
+    }
+    if (!trace_file.empty()) {
+        std::ofstream os(trace_file);
+        trace.write_chrome_trace(os);
+    }
+
     return 0;
 }
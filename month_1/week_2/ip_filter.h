@@ -25,7 +25,7 @@
  *
  * \endcode
 */
-std::vector<std::string> split(const std::string &str, char d)
+inline std::vector<std::string> split(const std::string &str, char d)
 {
     std::vector<std::string> r;
 
@@ -50,7 +50,7 @@ using ipv4_t = std::array<int, 4>;
 using ipv4_vec = std::vector<ipv4_t>;
 
 //! Given IPv4 address represented by 4 bytes convert it into 32bit unsigned integer number.
-uint32_t ipv4_to_uint(const ipv4_t& a){
+inline uint32_t ipv4_to_uint(const ipv4_t& a){
     uint32_t addr = 0;
     addr = a[0] << 24;
     addr |= a[1] << 16;
@@ -60,12 +60,12 @@ uint32_t ipv4_to_uint(const ipv4_t& a){
 }
 
 //! Given 32bit unsigned integer number convert it into IPv4 address represented by 4 bytes.
-ipv4_t uint_to_ipv4(const uint32_t& v){
+inline ipv4_t uint_to_ipv4(const uint32_t& v){
     return {uint8_t(v>>24&255), uint8_t(v>>16&255), uint8_t(v>>8&255), uint8_t(v&255)};
 }
 
 //! Prints pool of IPv4 addresses in rows
-void print_ip_pool(const ipv4_vec& ip_pool){
+inline void print_ip_pool(const ipv4_vec& ip_pool){
     for(const auto& a: ip_pool)
         std::cout << a[0] << '.' << a[1] << '.' << a[2] << '.' << a[3] << std::endl;
 }
@@ -110,7 +110,7 @@ void print_ip_pool(const ipv4_vec& ip_pool){
  *
  * \endcode
 */
-void sort(ipv4_vec& ip_pool, bool ascending=true) {
+inline void sort(ipv4_vec& ip_pool, bool ascending=true) {
     if (ascending)
         std::sort(ip_pool.begin(), ip_pool.end(), std::less<ipv4_t>());
     else
@@ -199,7 +199,7 @@ ipv4_vec filter(const ipv4_vec& ip_pool, const ipv4_t& positions, Args... args)
  *
  * \endcode
 */
-ipv4_vec filter2(const ipv4_vec& ip_pool, const ipv4_t& positions, const std::vector<int>& filter_vals) {
+inline ipv4_vec filter2(const ipv4_vec& ip_pool, const ipv4_t& positions, const std::vector<int>& filter_vals) {
     ipv4_vec ip_pool_filtrd;
     std::copy_if(ip_pool.begin(), ip_pool.end(), std::back_inserter(ip_pool_filtrd),
                  [positions, filter_vals](const ipv4_t& a) {
@@ -245,7 +245,7 @@ ipv4_vec filter2(const ipv4_vec& ip_pool, const ipv4_t& positions, const std::ve
  *
  * \endcode
 */
-ipv4_vec filter_positions(const ipv4_vec& ip_pool, const ipv4_t& filter_vals) {
+inline ipv4_vec filter_positions(const ipv4_vec& ip_pool, const ipv4_t& filter_vals) {
     ipv4_vec ip_pool_filtrd;
     std::copy_if(ip_pool.begin(), ip_pool.end(), std::back_inserter(ip_pool_filtrd),
                  [filter_vals](const ipv4_t& a) {
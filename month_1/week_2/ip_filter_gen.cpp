@@ -0,0 +1,318 @@
+// Synthetic log generator producing input in the format of ip_filter.tsv:
+//   <IPv4 address>\t<traffic>\t<traffic>
+//
+// Output is split into fixed size blocks generated in parallel and written in order,
+// each block is seeded from (seed, block index) so the same arguments always produce
+// the same file regardless of the number of threads.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef IP_FILTER_WITH_ZLIB
+#include "compressed_input.h"
+#endif
+
+struct options_t {
+    uint64_t size{64ull << 20};        //!< total output size in bytes
+    unsigned threads{std::max(1u, std::thread::hardware_concurrency())};
+    double zipf_s{1.1};                //!< Zipf exponent of /16 prefix popularity
+    uint32_t prefixes{65536};          //!< number of distinct /16 prefixes
+    double dup_rate{0.05};             //!< probability to repeat a recently generated address
+    uint64_t seed{42};
+    std::string output;                //!< output file, stdout if empty
+    bool bgzf{false};                  //!< compress output into BGZF blocks
+};
+
+constexpr size_t block_size = 4 << 20;
+constexpr size_t max_line_size = 64;
+constexpr size_t recent_size = 1024;
+
+
+//! Parses size with optional K/M/G/T binary suffix, e.g. 100G
+uint64_t parse_size(const std::string& str) {
+    size_t pos = 0;
+    uint64_t v = std::stoull(str, &pos);
+    if (pos == str.size()) {
+        return v;
+    }
+    if (pos + 1 != str.size()) {
+        throw std::invalid_argument("invalid size: " + str);
+    }
+    switch (std::toupper(str[pos])) {
+        case 'T': v <<= 10; // fall through
+        case 'G': v <<= 10; // fall through
+        case 'M': v <<= 10; // fall through
+        case 'K': v <<= 10; break;
+        default: throw std::invalid_argument("invalid size suffix: " + str);
+    }
+    return v;
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  -s SIZE     output size in bytes, K/M/G/T suffixes allowed (default 64M)\n"
+              << "  -t THREADS  number of generating threads (default: hardware concurrency)\n"
+              << "  -z S        Zipf exponent for /16 prefix skew, 0 - uniform (default 1.1)\n"
+              << "  -p N        number of distinct /16 prefixes, up to 65536 (default 65536)\n"
+              << "  -d RATE     duplicate address probability (default 0.05)\n"
+              << "  -r SEED     random seed (default 42)\n"
+              << "  -o FILE     output file (default stdout)\n"
+              << "  -c          compress output with BGZF (bgzip compatible, decoded by ip_filter in parallel)\n";
+}
+
+options_t parse_options(int argc, char const* argv[]) {
+    options_t opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            std::exit(0);
+        }
+        if (arg == "-c") {
+#ifndef IP_FILTER_WITH_ZLIB
+            throw std::invalid_argument("BGZF output is not supported by this build");
+#endif
+            opts.bgzf = true;
+            continue;
+        }
+        if (i + 1 >= argc || arg.size() != 2 || arg[0] != '-') {
+            throw std::invalid_argument("invalid argument: " + arg);
+        }
+        std::string val = argv[++i];
+        switch (arg[1]) {
+            case 's': opts.size = parse_size(val); break;
+            case 't': opts.threads = std::max(1ul, std::stoul(val)); break;
+            case 'z': opts.zipf_s = std::stod(val); break;
+            case 'p': opts.prefixes = std::min(65536ul, std::max(1ul, std::stoul(val))); break;
+            case 'd': opts.dup_rate = std::stod(val); break;
+            case 'r': opts.seed = std::stoull(val); break;
+            case 'o': opts.output = val; break;
+            default: throw std::invalid_argument("unknown option: " + arg);
+        }
+    }
+    return opts;
+}
+
+
+//! Zipf distributed /16 prefixes, rank r has probability proportional to 1 / r^s
+class prefix_dist_t {
+public:
+    prefix_dist_t(uint32_t n, double s, uint64_t seed): cdf_(n), prefixes_(65536) {
+        double sum = 0;
+        for (uint32_t r = 0; r < n; ++r) {
+            sum += 1.0 / std::pow(r + 1, s);
+            cdf_[r] = sum;
+        }
+        for (auto& c: cdf_) {
+            c /= sum;
+        }
+        // popular prefixes are spread over the whole address space
+        std::iota(prefixes_.begin(), prefixes_.end(), 0);
+        std::shuffle(prefixes_.begin(), prefixes_.end(), std::mt19937_64(seed));
+    }
+
+    template<typename Gen>
+    uint32_t operator()(Gen& gen) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        auto r = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return prefixes_[std::min<size_t>(r, cdf_.size() - 1)];
+    }
+
+private:
+    std::vector<double> cdf_;
+    std::vector<uint32_t> prefixes_;
+};
+
+
+inline char* append_uint(char* p, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+inline char* append_line(char* p, uint32_t addr, uint32_t traffic_in, uint32_t traffic_out) {
+    p = append_uint(p, addr >> 24);
+    *p++ = '.';
+    p = append_uint(p, addr >> 16 & 255);
+    *p++ = '.';
+    p = append_uint(p, addr >> 8 & 255);
+    *p++ = '.';
+    p = append_uint(p, addr & 255);
+    *p++ = '\t';
+    p = append_uint(p, traffic_in);
+    *p++ = '\t';
+    p = append_uint(p, traffic_out);
+    *p++ = '\n';
+    return p;
+}
+
+//! Samples of heavy tailed traffic values, indexed by random bits instead of drawing
+//! from lognormal_distribution per line
+struct traffic_table_t {
+    static constexpr size_t size = 4096;
+
+    explicit traffic_table_t(uint64_t seed) {
+        std::mt19937_64 gen(seed);
+        std::lognormal_distribution<double> in_dist(1.5, 1.8);
+        std::lognormal_distribution<double> out_dist(0.5, 1.2);
+        for (size_t i = 0; i < size; ++i) {
+            in[i] = uint32_t(std::min(in_dist(gen), 65535.0));
+            out[i] = uint32_t(std::min(out_dist(gen), 65535.0));
+        }
+    }
+
+    uint32_t in[size];
+    uint32_t out[size];
+};
+
+//! Fills buf with complete lines until at least size bytes are generated, returns generated size
+size_t generate_block(std::vector<char>& buf, size_t size, uint64_t block, const options_t& opts,
+                      const prefix_dist_t& prefix_dist, const traffic_table_t& traffic) {
+    std::seed_seq seq{uint32_t(opts.seed), uint32_t(opts.seed >> 32), uint32_t(block), uint32_t(block >> 32)};
+    std::mt19937_64 gen(seq);
+    const uint64_t dup_threshold = uint64_t(opts.dup_rate * 16384);
+
+    uint32_t recent[recent_size] = {};
+    size_t n_recent = 0;
+
+    buf.resize(size + max_line_size);
+    char* begin = buf.data();
+    char* p = begin;
+    while (size_t(p - begin) < size) {
+        // one 64 bit draw: 16 bits low half of address, 12+12 bits traffic, 10 bits zero out traffic,
+        // 14 bits duplicate
+        uint64_t r = gen();
+        uint32_t addr;
+        if (n_recent && (r >> 50) < dup_threshold) {
+            addr = recent[gen() % std::min(n_recent, recent_size)];
+        }
+        else {
+            addr = prefix_dist(gen) << 16 | uint32_t(r & 0xffff);
+            recent[n_recent++ % recent_size] = addr;
+        }
+        uint32_t in = traffic.in[r >> 16 & (traffic_table_t::size - 1)];
+        // the second traffic column is zero in ~60% of lines
+        uint32_t out = (r >> 40 & 1023) < 614 ? 0 : traffic.out[r >> 28 & (traffic_table_t::size - 1)];
+        p = append_line(p, addr, in, out);
+    }
+    return size_t(p - begin);
+}
+
+
+int main(int argc, char const* argv[])
+{
+    try
+    {
+        options_t opts = parse_options(argc, argv);
+
+        std::FILE* out = stdout;
+        if (!opts.output.empty()) {
+            out = std::fopen(opts.output.c_str(), "wb");
+            if (!out) {
+                throw std::runtime_error("failed to open " + opts.output + ": " + std::strerror(errno));
+            }
+        }
+
+        const prefix_dist_t prefix_dist(opts.prefixes, opts.zipf_s, opts.seed);
+        const traffic_table_t traffic(opts.seed);
+        const uint64_t n_blocks = (opts.size + block_size - 1) / block_size;
+
+        std::atomic<uint64_t> next_block{0};
+        uint64_t written_blocks = 0;
+        bool failed = false;
+        int write_errno = 0;               //!< errno of the first failed write, saved before other calls
+        std::mutex m;
+        std::condition_variable cv;
+
+        auto worker = [&]() {
+            std::vector<char> buf;
+            for (uint64_t b = next_block++; b < n_blocks; b = next_block++) {
+                size_t size = std::min<uint64_t>(block_size, opts.size - b * block_size);
+                size_t n = generate_block(buf, size, b, opts, prefix_dist, traffic);
+                const char* data = buf.data();
+#ifdef IP_FILTER_WITH_ZLIB
+                std::string compressed;
+                if (opts.bgzf) {
+                    compressed = bgzf_compress(buf.data(), n);
+                    data = compressed.data();
+                    n = compressed.size();
+                }
+#endif
+
+                // blocks are written strictly in order to keep output reproducible
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&]() { return written_blocks == b || failed; });
+                if (failed) {
+                    return;
+                }
+                if (std::fwrite(data, 1, n, out) != n) {
+                    write_errno = errno ? errno : EIO;
+                    failed = true;
+                }
+                ++written_blocks;
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < opts.threads; ++i) {
+            threads.emplace_back(worker);
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+
+#ifdef IP_FILTER_WITH_ZLIB
+        // bgzip and htslib readers treat BGZF without the empty end of file member as truncated
+        if (opts.bgzf && !failed) {
+            const std::string eof = bgzf_eof_block();
+            if (std::fwrite(eof.data(), 1, eof.size(), out) != eof.size()) {
+                write_errno = errno ? errno : EIO;
+                failed = true;
+            }
+        }
+#endif
+        // errors of buffered writes may show up only on flush or close
+        if (!failed && std::fflush(out) != 0) {
+            write_errno = errno ? errno : EIO;
+            failed = true;
+        }
+        if (out != stdout && std::fclose(out) != 0 && !failed) {
+            write_errno = errno ? errno : EIO;
+            failed = true;
+        }
+        if (failed) {
+            throw std::runtime_error(std::string("failed to write output: ") + std::strerror(write_errno));
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "query_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//! Load generator for `ip_filter --serve`, reports QPS and latency percentiles
+/*!
+ * Usage: ip_filter_load SOCKET [-c clients] [-n requests per client]
+ *
+ * Each client sends filter_positions queries with random first byte, one at a time, and records
+ * round trip latency. Without SOCKET path an in-process server over a random pool is started.
+*/
+int main(int argc, char const *argv[])
+{
+    std::string socket_path;
+    unsigned clients = 8;
+    unsigned requests = 20000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            clients = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "-n" && i + 1 < argc) {
+            requests = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg[0] != '-' && socket_path.empty()) {
+            socket_path = arg;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [SOCKET] [-c clients] [-n requests per client]\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        std::unique_ptr<query_server_t> server;
+        std::atomic<bool> stop{false};
+        std::thread server_thread;
+        if (socket_path.empty()) {
+            socket_path = "ip_filter_load.sock";
+            std::mt19937 gen(1);
+            std::uniform_int_distribution<int> byte(0, 255);
+            ipv4_vec ip_pool(1 << 20);
+            for (auto& a: ip_pool) {
+                a = {byte(gen), byte(gen), byte(gen), byte(gen)};
+            }
+            server.reset(new query_server_t(socket_path, std::move(ip_pool)));
+            server_thread = std::thread([&]() { server->run(stop); });
+        }
+
+        std::vector<std::vector<double>> latencies(clients);
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c]() {
+                query_client_t client(socket_path);
+                std::mt19937 gen(c);
+                std::uniform_int_distribution<int> byte(0, 255);
+                auto& lat = latencies[c];
+                lat.reserve(requests);
+                for (unsigned i = 0; i < requests; ++i) {
+                    auto t = std::chrono::steady_clock::now();
+                    client.filter_positions({byte(gen), byte(gen), -1, -1});
+                    lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+                }
+            });
+        }
+        for (auto& t: threads) {
+            t.join();
+        }
+        const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const auto& lat: latencies) {
+            all.insert(all.end(), lat.begin(), lat.end());
+        }
+        if (all.empty()) {
+            throw std::invalid_argument("no requests were sent");
+        }
+        std::sort(all.begin(), all.end());
+        auto pct = [&all](double p) { return all[static_cast<std::size_t>(p * (all.size() - 1))]; };
+        std::cout << "clients: " << clients << " requests: " << all.size()
+                  << " qps: " << static_cast<uint64_t>(all.size() / sec)
+                  << " p50: " << pct(0.5) << " us p99: " << pct(0.99) << " us max: " << all.back() << " us\n";
+
+        if (server) {
+            stop = true;
+            server_thread.join();
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+#ifndef IP_FILTER_IPV6_H
+#define IP_FILTER_IPV6_H
+
+#include "ip_filter.h"
+#include "pipeline.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//! IPv6 address packed into two 64-bit words, most significant word first
+/*!
+ * Integer comparison of the words orders addresses the same way as comparison of their 16 bytes.
+*/
+struct ipv6_t {
+    uint64_t hi{0};
+    uint64_t lo{0};
+
+    //! Byte i of the address in network order
+    uint8_t byte(std::size_t i) const {
+        return static_cast<uint8_t>((i < 8 ? hi : lo) >> (56 - 8 * (i % 8)));
+    }
+};
+
+inline bool operator==(const ipv6_t& a, const ipv6_t& b) { return a.hi == b.hi && a.lo == b.lo; }
+inline bool operator!=(const ipv6_t& a, const ipv6_t& b) { return !(a == b); }
+inline bool operator<(const ipv6_t& a, const ipv6_t& b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); }
+inline bool operator>(const ipv6_t& a, const ipv6_t& b) { return b < a; }
+
+//! Pool of IPv6 addresses
+using ipv6_vec = std::vector<ipv6_t>;
+
+//! Given IPv4 address returns IPv4-mapped IPv6 address ::ffff:a.b.c.d
+inline ipv6_t ipv4_to_ipv6(const ipv4_t& a) {
+    return {0, 0xffff00000000ull | ipv4_to_uint(a)};
+}
+
+//! Whether address lies in ::ffff:0:0/96
+inline bool is_ipv4_mapped(const ipv6_t& a) {
+    return a.hi == 0 && (a.lo >> 32) == 0xffff;
+}
+
+//! Parses IPv6 address in full, `::`-compressed or embedded IPv4 form (::ffff:1.2.3.4)
+/*!
+ * \param p beginning of address
+ * \param end end of address, nothing but the address is allowed in [p, end)
+ * \return parsed address, throws std::invalid_argument for malformed input
+ *
+ * Example:
+ * \code
+ *
+ * parse_ipv6("2001:db8:0:0:0:0:0:1")  // -> 2001:db8::1
+ * parse_ipv6("2001:db8::1")           // -> 2001:db8::1
+ * parse_ipv6("::ffff:46.70.1.2")      // -> ipv4_to_ipv6({46,70,1,2})
+ *
+ * \endcode
+*/
+inline ipv6_t parse_ipv6(const char* p, const char* end) {
+    const char* const begin = p;
+    auto fail = [begin, end]() {
+        throw std::invalid_argument("invalid IPv6 address: " + std::string(begin, end));
+    };
+    auto hex = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    };
+
+    uint16_t groups[8] = {};
+    int n = 0;
+    int gap = -1;  // index of the group where "::" stands
+    if (p != end && *p == ':') {
+        if (end - p < 2 || p[1] != ':') {
+            fail();
+        }
+        gap = 0;
+        p += 2;
+    }
+    while (p != end) {
+        if (n == 8) {
+            fail();
+        }
+        const char* group = p;
+        unsigned v = 0;
+        for (; p != end && p - group < 5 && hex(*p) >= 0; ++p) {
+            v = v * 16 + static_cast<unsigned>(hex(*p));
+        }
+        if (p != end && *p == '.') {
+            // embedded IPv4 takes the last two groups
+            if (n > 6) {
+                fail();
+            }
+            uint32_t quad = 0;
+            if (!parse_dotted_quad(group, end, quad)) {
+                fail();
+            }
+            groups[n++] = static_cast<uint16_t>(quad >> 16);
+            groups[n++] = static_cast<uint16_t>(quad);
+            break;
+        }
+        if (p == group || p - group > 4) {
+            fail();
+        }
+        groups[n++] = static_cast<uint16_t>(v);
+        if (p == end) {
+            break;
+        }
+        if (*p++ != ':' || p == end) {
+            fail();
+        }
+        if (*p == ':') {
+            if (gap >= 0) {
+                fail();
+            }
+            gap = n;
+            ++p;
+        }
+    }
+    if (gap < 0 ? n != 8 : n > 7) {
+        fail();
+    }
+
+    uint16_t full[8] = {};
+    const int tail = gap < 0 ? 0 : n - gap;
+    for (int i = 0; i < n - tail; ++i) {
+        full[i] = groups[i];
+    }
+    for (int i = 0; i < tail; ++i) {
+        full[8 - tail + i] = groups[gap + i];
+    }
+    ipv6_t a;
+    for (int i = 0; i < 4; ++i) {
+        a.hi = a.hi << 16 | full[i];
+        a.lo = a.lo << 16 | full[4 + i];
+    }
+    return a;
+}
+
+inline ipv6_t parse_ipv6(const std::string& str) {
+    return parse_ipv6(str.data(), str.data() + str.size());
+}
+
+//! Formats address in the canonical text form of RFC 5952
+/*!
+ * Example:
+ * \code
+ *
+ * format_ipv6(parse_ipv6("2001:0DB8:0:0:0:0:0:1"))  // -> "2001:db8::1"
+ * format_ipv6(ipv4_to_ipv6({46,70,1,2}))            // -> "::ffff:46.70.1.2"
+ *
+ * \endcode
+*/
+inline std::string format_ipv6(const ipv6_t& a) {
+    char buf[64];
+    if (is_ipv4_mapped(a)) {
+        std::snprintf(buf, sizeof(buf), "::ffff:%u.%u.%u.%u", a.byte(12), a.byte(13), a.byte(14), a.byte(15));
+        return buf;
+    }
+    unsigned groups[8];
+    for (int i = 0; i < 8; ++i) {
+        groups[i] = static_cast<unsigned>(a.byte(2 * i)) << 8 | a.byte(2 * i + 1);
+    }
+    // the first longest run of at least two zero groups is replaced by "::"
+    int best = -1;
+    int best_len = 1;
+    for (int i = 0; i < 8;) {
+        int j = i;
+        while (j < 8 && groups[j] == 0) {
+            ++j;
+        }
+        if (j - i > best_len) {
+            best = i;
+            best_len = j - i;
+        }
+        i = j == i ? i + 1 : j;
+    }
+    std::string out;
+    for (int i = 0; i < 8; ++i) {
+        if (i == best) {
+            out += "::";
+            i += best_len - 1;
+            continue;
+        }
+        if (!out.empty() && out.back() != ':') {
+            out += ':';
+        }
+        std::snprintf(buf, sizeof(buf), "%x", groups[i]);
+        out += buf;
+    }
+    return out;
+}
+
+//! Prints given pool of addresses line by line, IPv4-mapped addresses are printed as IPv4
+inline void print_ip_pool(const ipv6_vec& ip_pool) {
+    for (const auto& a: ip_pool) {
+        if (is_ipv4_mapped(a)) {
+            std::cout << unsigned(a.byte(12)) << '.' << unsigned(a.byte(13)) << '.'
+                      << unsigned(a.byte(14)) << '.' << unsigned(a.byte(15)) << '\n';
+        }
+        else {
+            std::cout << format_ipv6(a) << '\n';
+        }
+    }
+}
+
+namespace ipv6_detail {
+    //! Buckets up to this size are finished with comparison sort
+    constexpr std::size_t radix_cutoff = 64;
+
+    //! MSD radix sort of [first, last) starting at byte i, buf is scratch space of the same size
+    template<typename Compare>
+    void radix_sort(ipv6_t* first, ipv6_t* last, ipv6_t* buf, std::size_t i, bool ascending, Compare comp) {
+        const auto n = static_cast<std::size_t>(last - first);
+        std::array<std::size_t, 256> counts;
+        // skip bytes equal in all addresses, such as the common prefix of IPv4-mapped addresses
+        for (;; ++i) {
+            if (n <= radix_cutoff || i == 16) {
+                std::sort(first, last, comp);
+                return;
+            }
+            counts.fill(0);
+            for (auto p = first; p != last; ++p) {
+                counts[p->byte(i)]++;
+            }
+            if (std::find(counts.begin(), counts.end(), n) == counts.end()) {
+                break;
+            }
+        }
+        // counts become bucket offsets, buckets are laid out in reverse for descending order
+        std::array<std::size_t, 256> offsets;
+        std::size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            const int bucket = ascending ? b : 255 - b;
+            offsets[bucket] = offset;
+            offset += counts[bucket];
+        }
+        auto next = offsets;
+        for (auto p = first; p != last; ++p) {
+            buf[next[p->byte(i)]++] = *p;
+        }
+        std::copy(buf, buf + n, first);
+        for (int b = 0; b < 256; ++b) {
+            if (counts[b] > 1) {
+                radix_sort(first + offsets[b], first + offsets[b] + counts[b], buf, i + 1, ascending, comp);
+            }
+        }
+    }
+}
+
+//! Sort given pool of IPv6 addresses
+/*!
+ * MSD radix sort over the 16 bytes: addresses are distributed by their first byte that differs,
+ * buckets are sorted recursively by the following bytes and small ones by comparison sort.
+ *
+ * \param ip_pool pool of IPv6 addresses
+ * \param ascending sort order
+*/
+inline void sort(ipv6_vec& ip_pool, bool ascending=true) {
+    ipv6_vec buf(ip_pool.size());
+    if (ascending) {
+        ipv6_detail::radix_sort(ip_pool.data(), ip_pool.data() + ip_pool.size(), buf.data(), 0, true, std::less<ipv6_t>());
+    }
+    else {
+        ipv6_detail::radix_sort(ip_pool.data(), ip_pool.data() + ip_pool.size(), buf.data(), 0, false, std::greater<ipv6_t>());
+    }
+}
+
+//! Filter matching addresses whose bits selected by mask are equal to value
+struct ipv6_filter_t {
+    ipv6_t value;
+    ipv6_t mask;
+
+    bool matches(const ipv6_t& a) const {
+        return (a.hi & mask.hi) == value.hi && (a.lo & mask.lo) == value.lo;
+    }
+};
+
+//! Filter matching addresses in the network prefix/bits
+inline ipv6_filter_t ipv6_prefix_filter(const ipv6_t& prefix, unsigned bits) {
+    if (bits > 128) {
+        throw std::invalid_argument("invalid IPv6 prefix length: " + std::to_string(bits));
+    }
+    ipv6_filter_t f;
+    f.mask.hi = bits == 0 ? 0 : bits >= 64 ? ~0ull : ~0ull << (64 - bits);
+    f.mask.lo = bits <= 64 ? 0 : bits == 128 ? ~0ull : ~0ull << (128 - bits);
+    f.value = {prefix.hi & f.mask.hi, prefix.lo & f.mask.lo};
+    return f;
+}
+
+//! Parses IPv6 filter given as network prefix or nibble mask
+/*!
+ * A nibble mask has all eight groups without "::"; '*' stands for any nibble, a group of a single
+ * '*' for any group. Like filter_positions for IPv4, it fixes any subset of positions.
+ *
+ * Example:
+ * \code
+ *
+ * parse_ipv6_filter("2001:db8::/32");             // addresses in 2001:db8::/32
+ * parse_ipv6_filter("::ffff:46.70.0.0/112");      // IPv4 addresses 46.70.*.*
+ * parse_ipv6_filter("2001:db8:*:*:*:*:*:1");      // any address of 2001:db8::/32 ending with :1
+ * parse_ipv6_filter("*:*:*:*:*:*:*:**46");        // last byte is 0x46
+ *
+ * \endcode
+*/
+inline ipv6_filter_t parse_ipv6_filter(const std::string& str) {
+    auto slash = str.find('/');
+    if (slash != std::string::npos) {
+        const auto bits = str.substr(slash + 1);
+        if (bits.empty() || bits.size() > 3 || bits.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::invalid_argument("invalid IPv6 filter: " + str);
+        }
+        return ipv6_prefix_filter(parse_ipv6(str.data(), str.data() + slash), static_cast<unsigned>(std::stoul(bits)));
+    }
+    auto groups = split(str, ':');
+    if (groups.size() != 8) {
+        throw std::invalid_argument("invalid IPv6 filter: " + str);
+    }
+    ipv6_filter_t f;
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+        auto g = groups[i] == "*" ? std::string("****") : groups[i];
+        if (g.empty() || g.size() > 4 || g.find_first_not_of("0123456789abcdefABCDEF*") != std::string::npos) {
+            throw std::invalid_argument("invalid IPv6 filter: " + str);
+        }
+        g.insert(0, 4 - g.size(), '0');
+        for (char c: g) {
+            const unsigned nibble = c == '*' ? 0 : static_cast<unsigned>(std::stoul(std::string(1, c), nullptr, 16));
+            const uint64_t mask = c == '*' ? 0 : 0xf;
+            auto& value = i < 4 ? f.value.hi : f.value.lo;
+            auto& m = i < 4 ? f.mask.hi : f.mask.lo;
+            value = value << 4 | nibble;
+            m = m << 4 | mask;
+        }
+    }
+    return f;
+}
+
+//! Filter given pool of IPv6 addresses, order of addresses is kept
+inline ipv6_vec filter(const ipv6_vec& ip_pool, const ipv6_filter_t& f) {
+    ipv6_vec filtered;
+    std::copy_if(ip_pool.begin(), ip_pool.end(), std::back_inserter(filtered),
+                 [&f](const ipv6_t& a) { return f.matches(a); });
+    return filtered;
+}
+
+//! Parses lines with IPv4 or IPv6 addresses in one pass, IPv4 addresses are appended IPv4-mapped
+/*!
+ * Counterpart of parse_ip_lines for ipv4_vec, so read_ip_pool<ipv6_vec>() reads mixed input.
+ * Both kinds are validated strictly, a malformed address throws std::invalid_argument.
+*/
+inline void parse_ip_lines(const char* p, const char* end, ipv6_vec& pool) {
+    while (p != end) {
+        const char* eol = std::find(p, end, '\n');
+        if (eol != p) {
+            const char* field_end = std::find(p, eol, '\t');
+            if (std::find(p, field_end, ':') != field_end) {
+                pool.push_back(parse_ipv6(p, field_end));
+            }
+            else {
+                pool.push_back(ipv4_to_ipv6(parse_ipv4(p, field_end)));
+            }
+        }
+        p = eol == end ? end : eol + 1;
+    }
+}
+
+#endif //IP_FILTER_IPV6_H
@@ -0,0 +1,468 @@
+#ifndef IP_FILTER_PIPELINE_H
+#define IP_FILTER_PIPELINE_H
+
+#include "ip_filter.h"
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef IP_FILTER_WITH_IO_URING
+#include <liburing.h>
+#endif
+
+//! Blocking queue of limited capacity linking pipeline stages
+/*!
+ * push blocks while the queue is full, pop blocks while it is empty. After close() push fails and
+ * pop drains remaining elements, then fails. Closing from a failed consumer unblocks its producer.
+*/
+template<typename T>
+class bounded_queue_t {
+public:
+    explicit bounded_queue_t(std::size_t capacity): capacity_(capacity) {}
+
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(m_);
+        not_full_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        queue_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& value) {
+        std::unique_lock<std::mutex> lock(m_);
+        not_empty_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return false;
+        }
+        value = std::move(queue_.front());
+        queue_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::deque<T> queue_;
+    bool closed_{false};
+    std::mutex m_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+//! Filter applied by the pipeline to each parsed block
+struct pipeline_filter_t {
+    //! true - address matches if any byte equals vals[0] (filter_any), false - filter_positions semantics
+    bool any{false};
+    ipv4_t vals{{-1, -1, -1, -1}};
+};
+
+//! Parses filter given on command line
+/*!
+ * Example:
+ * \code
+ *
+ * parse_pipeline_filter("46.70.-1.-1");  // filter_positions(ip_pool, {46,70,-1,-1})
+ * parse_pipeline_filter("any:46");       // filter(ip_pool, {1,1,1,1}, 46)
+ *
+ * \endcode
+*/
+inline pipeline_filter_t parse_pipeline_filter(const std::string& str) {
+    pipeline_filter_t f;
+    if (str.compare(0, 4, "any:") == 0) {
+        f.any = true;
+        f.vals[0] = std::stoi(str.substr(4));
+        return f;
+    }
+    auto vals = split(str, '.');
+    if (vals.size() != f.vals.size()) {
+        throw std::invalid_argument("invalid filter: " + str);
+    }
+    std::transform(vals.begin(), vals.end(), f.vals.begin(), [](const std::string& s) { return std::stoi(s); });
+    return f;
+}
+
+//! Counters of a pipeline run
+struct pipeline_stats_t {
+    uint64_t bytes{0};
+    uint64_t records{0};
+    uint64_t matches{0};
+    int64_t first_output_ns{-1};  //!< time from start to the first written match, -1 if nothing matched
+    int64_t total_ns{0};
+};
+
+//! Reads input in large blocks, using io_uring for regular files where available
+/*!
+ * Regular files are read at explicit offsets with up to queue_depth reads in flight (io_uring) or
+ * sequential pread, pipes and terminals fall back to read().
+*/
+class block_reader_t {
+public:
+    static constexpr std::size_t block_size = 1 << 20;
+    static constexpr unsigned queue_depth = 4;
+
+    explicit block_reader_t(int fd): fd_(fd) {
+        struct stat st{};
+        if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) {
+            regular_ = true;
+            file_size_ = static_cast<uint64_t>(st.st_size);
+            offset_ = static_cast<uint64_t>(lseek(fd_, 0, SEEK_CUR));
+        }
+#ifdef IP_FILTER_WITH_IO_URING
+        if (regular_ && io_uring_queue_init(queue_depth, &ring_, 0) == 0) {
+            uring_ = true;
+            submitted_ = offset_;
+            for (unsigned i = 0; i < queue_depth; ++i) {
+                submit(i);
+            }
+        }
+#endif
+    }
+    ~block_reader_t() {
+#ifdef IP_FILTER_WITH_IO_URING
+        if (uring_) {
+            // buffers of reads still in flight must outlive them
+            io_uring_cqe* cqe = nullptr;
+            while (inflight_ && io_uring_wait_cqe(&ring_, &cqe) == 0) {
+                io_uring_cqe_seen(&ring_, cqe);
+                --inflight_;
+            }
+            io_uring_queue_exit(&ring_);
+        }
+#endif
+    }
+    block_reader_t(const block_reader_t&) = delete;
+    block_reader_t& operator=(const block_reader_t&) = delete;
+
+    //! Reads next block into buf, returns number of bytes read, 0 at end of input
+    std::size_t next(std::vector<char>& buf) {
+#ifdef IP_FILTER_WITH_IO_URING
+        if (uring_) {
+            return next_uring(buf);
+        }
+#endif
+        buf.resize(block_size);
+        ssize_t n;
+        do {
+            n = regular_ ? pread(fd_, buf.data(), block_size, static_cast<off_t>(offset_))
+                         : read(fd_, buf.data(), block_size);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            throw std::system_error(errno, std::generic_category(), "failed to read input");
+        }
+        offset_ += static_cast<uint64_t>(n);
+        return static_cast<std::size_t>(n);
+    }
+
+private:
+#ifdef IP_FILTER_WITH_IO_URING
+    // slot i serves every queue_depth-th block, blocks are returned in file order
+    void submit(unsigned slot) {
+        slots_[slot].offset = submitted_;
+        slots_[slot].size = static_cast<std::size_t>(std::min<uint64_t>(block_size, file_size_ - submitted_));
+        slots_[slot].done = false;
+        if (!slots_[slot].size) {
+            return;
+        }
+        slots_[slot].buf.resize(block_size);
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        io_uring_prep_read(sqe, fd_, slots_[slot].buf.data(), static_cast<unsigned>(slots_[slot].size),
+                           slots_[slot].offset);
+        io_uring_sqe_set_data64(sqe, slot);
+        io_uring_submit(&ring_);
+        ++inflight_;
+        submitted_ += slots_[slot].size;
+    }
+
+    std::size_t next_uring(std::vector<char>& buf) {
+        auto& slot = slots_[next_slot_];
+        if (!slot.size) {
+            return 0;
+        }
+        while (!slot.done) {
+            io_uring_cqe* cqe = nullptr;
+            int ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (ret < 0) {
+                throw std::system_error(-ret, std::generic_category(), "io_uring wait failed");
+            }
+            auto& done = slots_[io_uring_cqe_get_data64(cqe)];
+            --inflight_;
+            if (cqe->res < 0 || static_cast<std::size_t>(cqe->res) != done.size) {
+                int err = cqe->res < 0 ? -cqe->res : EIO;
+                io_uring_cqe_seen(&ring_, cqe);
+                throw std::system_error(err, std::generic_category(), "io_uring read failed");
+            }
+            done.done = true;
+            io_uring_cqe_seen(&ring_, cqe);
+        }
+        std::size_t n = slot.size;
+        buf.swap(slot.buf);
+        submit(next_slot_);
+        next_slot_ = (next_slot_ + 1) % queue_depth;
+        return n;
+    }
+
+    struct slot_t {
+        std::vector<char> buf;
+        uint64_t offset{0};
+        std::size_t size{0};
+        bool done{false};
+    };
+
+    io_uring ring_{};
+    bool uring_{false};
+    slot_t slots_[queue_depth];
+    unsigned next_slot_{0};
+    unsigned inflight_{0};
+    uint64_t submitted_{0};
+#endif
+    int fd_;
+    bool regular_{false};
+    uint64_t file_size_{0};
+    uint64_t offset_{0};
+};
+
+//! Parses dotted-quad IPv4 address occupying all of [p, end)
+/*!
+ * Each octet is 1 to 3 decimal digits not greater than 255.
+ * \return false for malformed input, otherwise the address in host order is stored to quad
+*/
+inline bool parse_dotted_quad(const char* p, const char* end, uint32_t& quad) {
+    uint32_t a = 0;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t b = 0;
+        const char* digits = p;
+        for (; p != end && *p >= '0' && *p <= '9' && p - digits < 3; ++p) {
+            b = b * 10 + static_cast<uint32_t>(*p - '0');
+        }
+        if (p == digits || b > 255 || (i < 3 && (p == end || *p++ != '.'))) {
+            return false;
+        }
+        a = a << 8 | b;
+    }
+    if (p != end) {
+        return false;
+    }
+    quad = a;
+    return true;
+}
+
+//! Parses IPv4 address of a line, [p, end) is the first field without the tab
+/*!
+ * Same strict rules as parse_dotted_quad: four octets 0..255 and nothing after the fourth,
+ * throws std::invalid_argument otherwise.
+*/
+inline ipv4_t parse_ipv4(const char* p, const char* end) {
+    uint32_t quad = 0;
+    if (!parse_dotted_quad(p, end, quad)) {
+        throw std::invalid_argument("invalid IPv4 address: " + std::string(p, end));
+    }
+    return {int(quad >> 24), int(quad >> 16 & 255), int(quad >> 8 & 255), int(quad & 255)};
+}
+
+//! Parses lines in the format of ip_filter.tsv, appends addresses to pool, empty lines are skipped
+inline void parse_ip_lines(const char* p, const char* end, ipv4_vec& pool) {
+    while (p != end) {
+        const char* eol = std::find(p, end, '\n');
+        if (eol != p) {
+            pool.push_back(parse_ipv4(p, std::find(p, eol, '\t')));
+        }
+        p = eol == end ? end : eol + 1;
+    }
+}
+
+//! Reads and parses whole input
+/*!
+ * \tparam Pool ipv4_vec, or ipv6_vec for mixed IPv4 and IPv6 input (see ipv6.h)
+ * \tparam Reader type with `std::size_t next(std::vector<char>& buf)`, such as block_reader_t
+*/
+template<typename Pool = ipv4_vec, typename Reader>
+Pool read_ip_pool(Reader& input) {
+    Pool pool;
+    std::vector<char> buf;
+    std::string tail;
+    for (std::size_t n; (n = input.next(buf)) > 0;) {
+        tail.append(buf.data(), n);
+        auto last = tail.rfind('\n');
+        if (last != std::string::npos) {
+            parse_ip_lines(tail.data(), tail.data() + last + 1, pool);
+            tail.erase(0, last + 1);
+        }
+    }
+    parse_ip_lines(tail.data(), tail.data() + tail.size(), pool);
+    return pool;
+}
+
+//! Filters input and writes matching addresses to out in input order
+/*!
+ * Input is read, parsed, filtered and formatted by separate threads linked by bounded queues, so
+ * matches are written while the rest of input is still being read.
+ *
+ * \tparam Reader type with `std::size_t next(std::vector<char>& buf)` returning blocks of input,
+ *                0 at end of input, such as block_reader_t
+ * \param input input reader, blocks are passed to the parser without copying
+ * \param out output stream, flushed after each block with matches
+ * \param f filter
+ * \param stats optional run counters
+*/
+template<typename Reader>
+void run_pipeline(Reader& input, std::FILE* out, const pipeline_filter_t& f, pipeline_stats_t* stats = nullptr) {
+    using steady_clock = std::chrono::steady_clock;
+    const auto start = steady_clock::now();
+    constexpr std::size_t queue_capacity = 4;
+
+    struct text_t {
+        std::vector<char> data;
+        std::size_t size{0};
+    };
+    bounded_queue_t<text_t> blocks(queue_capacity);
+    bounded_queue_t<ipv4_vec> parsed(queue_capacity);
+    bounded_queue_t<ipv4_vec> matched(queue_capacity);
+
+    pipeline_stats_t st;
+    std::mutex error_m;
+    std::exception_ptr error;
+    // runs body on a new thread, closes stage queues when it finishes or fails so that neighbouring
+    // stages are never left blocked
+    auto stage = [&](auto body, auto close_queues) {
+        return std::thread([&error_m, &error, body, close_queues]() {
+            try {
+                body();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_m);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            close_queues();
+        });
+    };
+
+    std::thread reader = stage([&]() {
+        for (;;) {
+            text_t block;
+            block.size = input.next(block.data);
+            st.bytes += block.size;
+            if (!block.size || !blocks.push(std::move(block))) {
+                break;
+            }
+        }
+    }, [&]() { blocks.close(); });
+
+    std::thread parser = stage([&]() {
+        std::string tail;
+        text_t block;
+        while (blocks.pop(block)) {
+            const char* begin = block.data.data();
+            const char* end = begin + block.size;
+            const char* last = end;
+            while (last != begin && last[-1] != '\n') {
+                --last;
+            }
+            ipv4_vec pool;
+            pool.reserve(block.size / 16);
+            if (last == begin) {
+                // no line ends in this block
+                tail.append(begin, end);
+                continue;
+            }
+            if (!tail.empty()) {
+                const char* eol = std::find(begin, end, '\n');
+                tail.append(begin, eol + 1);
+                parse_ip_lines(tail.data(), tail.data() + tail.size(), pool);
+                tail.clear();
+                begin = eol + 1;
+            }
+            parse_ip_lines(begin, last, pool);
+            tail.assign(last, end);
+            if (!parsed.push(std::move(pool))) {
+                return;
+            }
+        }
+        if (!tail.empty()) {
+            ipv4_vec pool;
+            parse_ip_lines(tail.data(), tail.data() + tail.size(), pool);
+            parsed.push(std::move(pool));
+        }
+    }, [&]() { blocks.close(); parsed.close(); });
+
+    std::thread filterer = stage([&]() {
+        ipv4_vec pool;
+        while (parsed.pop(pool)) {
+            st.records += pool.size();
+            auto m = f.any ? filter(pool, {1,1,1,1}, f.vals[0]) : filter_positions(pool, f.vals);
+            if (!m.empty() && !matched.push(std::move(m))) {
+                return;
+            }
+        }
+    }, [&]() { parsed.close(); matched.close(); });
+
+    std::thread writer = stage([&]() {
+        ipv4_vec pool;
+        std::string text;
+        while (matched.pop(pool)) {
+            text.clear();
+            for (const auto& a: pool) {
+                for (std::size_t i = 0; i < a.size(); ++i) {
+                    if (i) {
+                        text += '.';
+                    }
+                    text += std::to_string(a[i]);
+                }
+                text += '\n';
+            }
+            if (std::fwrite(text.data(), 1, text.size(), out) != text.size() || std::fflush(out) != 0) {
+                throw std::runtime_error("failed to write output");
+            }
+            if (st.first_output_ns < 0) {
+                st.first_output_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    steady_clock::now() - start).count();
+            }
+            st.matches += pool.size();
+        }
+    }, [&]() { matched.close(); });
+
+    reader.join();
+    parser.join();
+    filterer.join();
+    writer.join();
+    st.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - start).count();
+    if (stats) {
+        *stats = st;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+//! Filters input read from file descriptor, regular file or pipe, see run_pipeline above
+inline void run_pipeline(int fd, std::FILE* out, const pipeline_filter_t& f, pipeline_stats_t* stats = nullptr) {
+    block_reader_t input(fd);
+    run_pipeline(input, out, f, stats);
+}
+
+#endif //IP_FILTER_PIPELINE_H
@@ -0,0 +1,792 @@
+#ifndef IP_FILTER_QUERY_SERVER_H
+#define IP_FILTER_QUERY_SERVER_H
+
+#include "compressed_input.h"
+#include "ip_filter.h"
+#include "pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//! Binary protocol of the query server
+/*!
+ * All integers are in native byte order, the server is reachable only by local clients.
+ *
+ * Request:  uint32 payload size, uint8 op, payload
+ *   op_filter            uint8 positions[4], uint8 n, int16 vals[n]   - filter/filter2 semantics
+ *   op_filter_positions  int16 vals[4]                                - filter_positions semantics
+ *   op_reload            empty                                        - reload pool from its file
+ *
+ * Response: uint8 status, uint32 count, count addresses of 4 bytes each, in descending order
+*/
+namespace query_proto {
+    constexpr uint8_t op_filter = 1;
+    constexpr uint8_t op_filter_positions = 2;
+    constexpr uint8_t op_reload = 3;
+
+    constexpr uint8_t status_ok = 0;
+    constexpr uint8_t status_bad_request = 1;
+
+    constexpr std::size_t header_size = 5;
+    constexpr std::size_t response_header_size = 5;
+    constexpr uint32_t max_payload = 1024;
+
+    template<typename T>
+    void put(std::string& buf, T v) {
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    template<typename T>
+    T get(const char* p) {
+        T v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline std::string make_request(uint8_t op, const std::string& payload) {
+        std::string buf;
+        put(buf, uint32_t(payload.size()));
+        put(buf, op);
+        return buf + payload;
+    }
+}
+
+//! Immutable sorted pool answering queries, shared by readers while a reload builds the next one
+class pool_snapshot_t {
+public:
+    explicit pool_snapshot_t(ipv4_vec ip_pool): pool_(std::move(ip_pool)) {
+        sort(pool_, false);
+    }
+
+    const ipv4_vec& pool() const {
+        return pool_;
+    }
+
+    //! filter/filter2 over the whole pool
+    ipv4_vec filter(const ipv4_t& positions, const std::vector<int>& vals) const {
+        return filter2(pool_, positions, vals);
+    }
+
+    //! filter_positions narrowed by binary search on the first byte when it is fixed
+    ipv4_vec filter_positions(const ipv4_t& vals) const {
+        if (vals[0] <= 0) {
+            return ::filter_positions(pool_, vals);
+        }
+        auto range = std::equal_range(pool_.begin(), pool_.end(), ipv4_t{vals[0], 0, 0, 0},
+                                      [](const ipv4_t& a, const ipv4_t& b) { return a[0] > b[0]; });
+        return ::filter_positions(ipv4_vec(range.first, range.second), vals);
+    }
+
+private:
+    ipv4_vec pool_;
+};
+
+//! Loads pool of addresses from plain or compressed file in the format of ip_filter.tsv
+inline ipv4_vec load_ip_pool(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "failed to open " + path);
+    }
+    try {
+        input_reader_t input(fd);
+        auto pool = read_ip_pool(input);
+        close(fd);
+        return pool;
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+//! Atomic pointer to an immutable object, freed with hazard pointers once no reader uses it
+/*!
+ * Readers never lock: a reader claims a free slot by storing the current pointer there with a CAS
+ * and rechecks that the pointer is still current. A writer swaps the pointer, waits until no slot
+ * holds the old object and deletes it, so a write may wait for readers but a read never waits for a
+ * write. Writers are serialized by a mutex. A reader finding all slots taken yields and retries, so
+ * the number of slots should cover the threads reading at once.
+*/
+template<typename T>
+class hazard_ptr_t {
+public:
+    //! Read access to the object that was current when it was taken, frees its slot on destruction
+    class guard_t {
+    public:
+        guard_t(std::atomic<const T*>* slot, const T* ptr): slot_(slot), ptr_(ptr) {}
+        guard_t(guard_t&& other) noexcept: slot_(other.slot_), ptr_(other.ptr_) {
+            other.slot_ = nullptr;
+        }
+        ~guard_t() {
+            if (slot_) {
+                slot_->store(nullptr, std::memory_order_release);
+            }
+        }
+        guard_t(const guard_t&) = delete;
+        guard_t& operator=(const guard_t&) = delete;
+        guard_t& operator=(guard_t&&) = delete;
+
+        const T& operator*() const { return *ptr_; }
+        const T* operator->() const { return ptr_; }
+
+    private:
+        std::atomic<const T*>* slot_;
+        const T* ptr_;
+    };
+
+    //! value must not be null
+    hazard_ptr_t(std::unique_ptr<const T> value, std::size_t slots)
+        : slots_(std::max<std::size_t>(1, slots)), current_(value.release()) {}
+    ~hazard_ptr_t() {
+        delete current_.load();
+    }
+    hazard_ptr_t(const hazard_ptr_t&) = delete;
+    hazard_ptr_t& operator=(const hazard_ptr_t&) = delete;
+
+    //! Current object, the guard must not outlive hazard_ptr_t
+    guard_t read() const {
+        for (;;) {
+            const T* p = current_.load();
+            for (auto& s: slots_) {
+                const T* expected = nullptr;
+                if (!s.ptr.compare_exchange_strong(expected, p)) {
+                    continue;
+                }
+                // p may have been replaced, and then deleted by a writer that scanned this slot
+                // before it was claimed, the recheck makes sure the published pointer is live
+                for (const T* q = current_.load(); q != p; q = current_.load()) {
+                    p = q;
+                    s.ptr.store(p);
+                }
+                return guard_t(&s.ptr, p);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    //! Replaces the object, returns once the previous one is deleted. Must not be called by a
+    //! thread holding a guard.
+    void store(std::unique_ptr<const T> value) {
+        std::lock_guard<std::mutex> lock(write_m_);
+        const T* old = current_.exchange(value.release());
+        for (const auto& s: slots_) {
+            while (s.ptr.load() == old) {
+                std::this_thread::yield();
+            }
+        }
+        delete old;
+    }
+
+private:
+    struct slot_t {
+        std::atomic<const T*> ptr{nullptr};
+        // slots of different readers stay on separate cache lines
+        char pad[64 - sizeof(std::atomic<const T*>)];
+    };
+
+    mutable std::vector<slot_t> slots_;
+    std::atomic<const T*> current_;
+    std::mutex write_m_;
+};
+
+//! Resident server answering filter queries over a Unix domain socket
+/*!
+ * The pool is loaded and sorted once. One thread polls the sockets and only moves bytes: requests
+ * that arrive together are collected into a batch, and batches are evaluated by a fixed pool of
+ * worker threads, so a heavy query does not stall other clients. A batch is answered from a single
+ * snapshot and identical requests in it are evaluated once.
+ *
+ * Queries never lock: the snapshot is a hazard_ptr_t. A reload runs on a background thread, builds
+ * the next snapshot while queries continue and swaps it in; the previous snapshot is freed once the
+ * last batch using it is done.
+ *
+ * A connection has at most one batch in flight, so its replies keep request order. The server stops
+ * reading from a connection while more than max_buffered_output bytes of its replies are unsent, so a
+ * client that does not read its replies cannot make the server buffer without bound.
+ *
+ * Example:
+ * \code
+ *
+ * query_server_t server("/tmp/ip_filter.sock", "ip_filter.tsv");
+ * std::atomic<bool> stop{false};
+ * std::thread t([&]() { server.run(stop); });
+ *
+ * query_client_t client("/tmp/ip_filter.sock");
+ * print_ip_pool(client.filter_positions({46,70,-1,-1}));
+ *
+ * stop = true;
+ * t.join();
+ *
+ * \endcode
+*/
+class query_server_t {
+public:
+    using snapshot_ptr_t = hazard_ptr_t<pool_snapshot_t>;
+
+    static constexpr std::size_t max_pipelined = 16;             //!< requests of one connection in a batch
+    static constexpr std::size_t max_buffered_input = 64 << 10;  //!< bytes read ahead from one connection
+    static constexpr std::size_t max_buffered_output = 4 << 20;  //!< unsent reply bytes that pause reading
+
+    //! Binds socket at given path and loads pool from file, threads - number of query workers
+    query_server_t(const std::string& socket_path, const std::string& pool_path,
+                   unsigned threads = std::thread::hardware_concurrency())
+        : query_server_t(socket_path, load_ip_pool(pool_path), threads) {
+        pool_path_ = pool_path;
+    }
+
+    //! Binds socket at given path and serves given pool, reload is not available
+    /*!
+     * A stale socket left at socket_path is replaced, any other file there is an error and is kept.
+    */
+    query_server_t(const std::string& socket_path, ipv4_vec ip_pool,
+                   unsigned threads = std::thread::hardware_concurrency())
+        : socket_path_(socket_path), threads_(std::max(1u, threads)),
+          // a slot per worker and a few for snapshot() callers
+          snapshot_(std::unique_ptr<const pool_snapshot_t>(new pool_snapshot_t(std::move(ip_pool))), threads_ + 4) {
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            throw std::invalid_argument("socket path is too long: " + socket_path);
+        }
+        struct stat st{};
+        if (lstat(socket_path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                throw std::runtime_error("refusing to replace " + socket_path + ": not a socket");
+            }
+            unlink(socket_path.c_str());
+        }
+        else if (errno != ENOENT) {
+            throw std::system_error(errno, std::generic_category(), "failed to stat " + socket_path);
+        }
+        if (pipe(wake_fds_) < 0) {
+            throw std::system_error(errno, std::generic_category(), "pipe failed");
+        }
+        set_nonblocking(wake_fds_[0]);
+        set_nonblocking(wake_fds_[1]);
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            listen(listen_fd_, 128) < 0 || lstat(socket_path.c_str(), &st) < 0) {
+            int err = errno;
+            if (listen_fd_ >= 0) {
+                close(listen_fd_);
+            }
+            close(wake_fds_[0]);
+            close(wake_fds_[1]);
+            throw std::system_error(err, std::generic_category(), "failed to listen on " + socket_path);
+        }
+        // identity of the bound socket, so the destructor removes only the file this server created
+        socket_dev_ = st.st_dev;
+        socket_ino_ = st.st_ino;
+        set_nonblocking(listen_fd_);
+    }
+
+    ~query_server_t() {
+        if (reload_thread_.joinable()) {
+            reload_thread_.join();
+        }
+        for (auto& c: conns_) {
+            close(c.second.fd);
+        }
+        close(listen_fd_);
+        close(wake_fds_[0]);
+        close(wake_fds_[1]);
+        struct stat st{};
+        if (lstat(socket_path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+            st.st_dev == socket_dev_ && st.st_ino == socket_ino_) {
+            unlink(socket_path_.c_str());
+        }
+    }
+    query_server_t(const query_server_t&) = delete;
+    query_server_t& operator=(const query_server_t&) = delete;
+
+    //! Current snapshot, safe to call from any thread, lock-free
+    snapshot_ptr_t::guard_t snapshot() const {
+        return snapshot_.read();
+    }
+
+    //! Replaces pool, batches already running keep using the previous snapshot
+    /*!
+     * Returns once the previous snapshot is freed, so it must not be called while holding snapshot().
+    */
+    void swap_pool(ipv4_vec ip_pool) {
+        snapshot_.store(std::unique_ptr<const pool_snapshot_t>(new pool_snapshot_t(std::move(ip_pool))));
+        reloads_++;
+    }
+
+    //! Number of completed reloads
+    uint64_t reloads() const {
+        return reloads_;
+    }
+
+    //! Serves connections until stop is set, checked at least every poll_timeout_ms
+    void run(const std::atomic<bool>& stop) {
+        // at most one batch per connection is queued, so the queue needs no bound of its own
+        bounded_queue_t<std::vector<request_t>> batches(std::numeric_limits<std::size_t>::max());
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads_; ++i) {
+            workers.emplace_back([this, &batches]() {
+                std::vector<request_t> batch;
+                while (batches.pop(batch)) {
+                    answer(batch);
+                }
+            });
+        }
+        auto stop_workers = [&batches, &workers]() {
+            batches.close();
+            for (auto& t: workers) {
+                t.join();
+            }
+        };
+        try {
+            serve(stop, batches);
+        }
+        catch (...) {
+            stop_workers();
+            throw;
+        }
+        stop_workers();
+    }
+
+private:
+    struct conn_t {
+        int fd;
+        std::string in;
+        std::string out;
+        std::size_t out_pos{0};
+        bool busy{false};    //!< a batch with requests of this connection is being evaluated
+        bool closed{false};
+    };
+
+    struct request_t {
+        uint64_t conn;
+        std::string body;  //!< op and payload
+    };
+
+    //! Replies to all requests of one connection in a batch
+    struct reply_t {
+        uint64_t conn;
+        std::string data;
+    };
+
+    static void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    //! Whether new requests of the connection may be read and evaluated
+    static bool accepts_requests(const conn_t& c) {
+        return !c.busy && !c.closed && c.out.size() - c.out_pos <= max_buffered_output;
+    }
+
+    static bool has_request(const conn_t& c) {
+        return c.in.size() >= query_proto::header_size &&
+               c.in.size() >= query_proto::header_size + query_proto::get<uint32_t>(c.in.data());
+    }
+
+    void serve(const std::atomic<bool>& stop, bounded_queue_t<std::vector<request_t>>& batches) {
+        constexpr int poll_timeout_ms = 100;
+        std::vector<pollfd> fds;
+        std::vector<uint64_t> ids;
+        while (!stop) {
+            fds.clear();
+            ids.clear();
+            fds.push_back({listen_fd_, POLLIN, 0});
+            fds.push_back({wake_fds_[0], POLLIN, 0});
+            // requests already buffered by a connection that was paused are taken without waiting
+            bool ready = false;
+            for (const auto& item: conns_) {
+                const conn_t& c = item.second;
+                short events = 0;
+                if (accepts_requests(c)) {
+                    events |= c.in.size() < max_buffered_input ? POLLIN : 0;
+                    ready = ready || has_request(c);
+                }
+                if (c.out.size() > c.out_pos) {
+                    events |= POLLOUT;
+                }
+                fds.push_back({c.fd, events, 0});
+                ids.push_back(item.first);
+            }
+            int n = poll(fds.data(), fds.size(), ready ? 0 : poll_timeout_ms);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "poll failed");
+            }
+            if (fds[0].revents & POLLIN) {
+                accept_all();
+            }
+            if (fds[1].revents & POLLIN) {
+                char buf[64];
+                while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {}
+            }
+            take_replies();
+            // conns_ may have grown by accept_all, only the polled ones have revents
+            for (std::size_t i = 2; i < fds.size(); ++i) {
+                conn_t& c = conns_.at(ids[i - 2]);
+                if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && accepts_requests(c)) {
+                    read_input(c);
+                }
+                else if (fds[i].revents & (POLLHUP | POLLERR)) {
+                    // paused connection is gone, its batch in flight is answered to nobody
+                    c.closed = true;
+                }
+            }
+            std::vector<request_t> batch;
+            for (auto& item: conns_) {
+                if (accepts_requests(item.second)) {
+                    take_requests(item.first, item.second, batch);
+                }
+            }
+            if (!batch.empty()) {
+                batches.push(std::move(batch));
+            }
+            for (auto it = conns_.begin(); it != conns_.end();) {
+                flush(it->second);
+                if (it->second.closed) {
+                    close(it->second.fd);
+                    it = conns_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    void accept_all() {
+        for (;;) {
+            int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            set_nonblocking(fd);
+            conns_.emplace(next_conn_++, conn_t{fd, {}, {}, 0, false, false});
+        }
+    }
+
+    void read_input(conn_t& c) {
+        char buf[4096];
+        while (c.in.size() < max_buffered_input) {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n > 0) {
+                c.in.append(buf, static_cast<std::size_t>(n));
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                c.closed = true;
+            }
+            if (n == 0 || errno != EINTR) {
+                break;
+            }
+        }
+    }
+
+    //! Moves up to max_pipelined complete requests of the connection into batch
+    void take_requests(uint64_t id, conn_t& c, std::vector<request_t>& batch) {
+        std::size_t pos = 0;
+        for (std::size_t taken = 0; taken < max_pipelined && c.in.size() - pos >= query_proto::header_size; ++taken) {
+            auto size = query_proto::get<uint32_t>(c.in.data() + pos);
+            if (size > query_proto::max_payload) {
+                c.closed = true;
+                break;
+            }
+            if (c.in.size() - pos < query_proto::header_size + size) {
+                break;
+            }
+            batch.push_back({id, c.in.substr(pos + 4, 1 + size)});
+            pos += query_proto::header_size + size;
+            c.busy = true;
+        }
+        c.in.erase(0, pos);
+    }
+
+    //! Appends replies finished by workers to their connections
+    void take_replies() {
+        std::vector<reply_t> replies;
+        {
+            std::lock_guard<std::mutex> lock(replies_m_);
+            replies.swap(replies_);
+        }
+        for (auto& r: replies) {
+            auto it = conns_.find(r.conn);
+            if (it == conns_.end()) {
+                // connection was closed while its batch was evaluated
+                continue;
+            }
+            it->second.out += r.data;
+            it->second.busy = false;
+        }
+    }
+
+    //! Evaluates batch on a worker thread and hands replies to the polling thread
+    void answer(const std::vector<request_t>& batch) {
+        std::vector<reply_t> replies;
+        {
+            // one snapshot for the whole batch, identical requests are evaluated once
+            auto snap = snapshot_.read();
+            std::map<std::string, std::string> responses;
+            for (const auto& r: batch) {
+                auto it = responses.find(r.body);
+                if (it == responses.end()) {
+                    it = responses.emplace(r.body, evaluate(*snap, r.body)).first;
+                }
+                // requests of a connection are adjacent in the batch
+                if (replies.empty() || replies.back().conn != r.conn) {
+                    replies.push_back({r.conn, {}});
+                }
+                replies.back().data += it->second;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(replies_m_);
+            for (auto& r: replies) {
+                replies_.push_back(std::move(r));
+            }
+        }
+        const char wake = 0;
+        if (write(wake_fds_[1], &wake, 1) < 0) {
+            // the pipe is full, so the polling thread wakes up anyway
+        }
+    }
+
+    std::string evaluate(const pool_snapshot_t& snap, const std::string& body) {
+        using namespace query_proto;
+        const uint8_t op = uint8_t(body[0]);
+        const char* p = body.data() + 1;
+        const std::size_t size = body.size() - 1;
+        ipv4_vec result;
+        if (op == op_filter && size >= 5 && size == 5 + 2 * std::size_t(uint8_t(p[4]))) {
+            ipv4_t positions{uint8_t(p[0]), uint8_t(p[1]), uint8_t(p[2]), uint8_t(p[3])};
+            std::vector<int> vals(static_cast<std::size_t>(uint8_t(p[4])));
+            for (std::size_t i = 0; i < vals.size(); ++i) {
+                vals[i] = get<int16_t>(p + 5 + 2 * i);
+            }
+            result = snap.filter(positions, vals);
+        }
+        else if (op == op_filter_positions && size == 8) {
+            ipv4_t vals{get<int16_t>(p), get<int16_t>(p + 2), get<int16_t>(p + 4), get<int16_t>(p + 6)};
+            result = snap.filter_positions(vals);
+        }
+        else if (!(op == op_reload && size == 0 && start_reload())) {
+            std::string out;
+            put(out, status_bad_request);
+            put(out, uint32_t(0));
+            return out;
+        }
+        std::string out;
+        out.reserve(response_header_size + 4 * result.size());
+        put(out, status_ok);
+        put(out, uint32_t(result.size()));
+        for (const auto& a: result) {
+            out += char(a[0]);
+            out += char(a[1]);
+            out += char(a[2]);
+            out += char(a[3]);
+        }
+        return out;
+    }
+
+    //! Starts loading pool on a background thread, false if reload is not available
+    /*!
+     * Called by workers concurrently, the reload thread is replaced under reload_m_.
+    */
+    bool start_reload() {
+        if (pool_path_.empty()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(reload_m_);
+        if (reloading_) {
+            // the running reload may have read the file already, run one more after it
+            reload_pending_ = true;
+            return true;
+        }
+        reloading_ = true;
+        // the previous reload thread has cleared reloading_ and only returns, it does not need reload_m_
+        if (reload_thread_.joinable()) {
+            reload_thread_.join();
+        }
+        reload_thread_ = std::thread([this]() {
+            for (;;) {
+                try {
+                    swap_pool(load_ip_pool(pool_path_));
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "reload failed: " << e.what() << std::endl;
+                }
+                std::lock_guard<std::mutex> lock(reload_m_);
+                if (!reload_pending_) {
+                    reloading_ = false;
+                    return;
+                }
+                reload_pending_ = false;
+            }
+        });
+        return true;
+    }
+
+    void flush(conn_t& c) {
+        while (c.out_pos < c.out.size()) {
+            // MSG_NOSIGNAL: a client gone before reading its reply must not kill the server with SIGPIPE
+            ssize_t n = send(c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    c.closed = true;
+                }
+                // drop the part already sent once it outgrows the rest
+                if (c.out_pos > c.out.size() / 2) {
+                    c.out.erase(0, c.out_pos);
+                    c.out_pos = 0;
+                }
+                return;
+            }
+            c.out_pos += static_cast<std::size_t>(n);
+        }
+        c.out.clear();
+        c.out_pos = 0;
+    }
+
+    std::string socket_path_;
+    std::string pool_path_;
+    unsigned threads_;
+    snapshot_ptr_t snapshot_;
+    int listen_fd_{-1};
+    dev_t socket_dev_{0};
+    ino_t socket_ino_{0};
+    int wake_fds_[2]{-1, -1};  //!< workers write a byte to wake the polling thread when replies are ready
+    std::map<uint64_t, conn_t> conns_;
+    uint64_t next_conn_{0};
+    std::mutex replies_m_;
+    std::vector<reply_t> replies_;
+    std::atomic<uint64_t> reloads_{0};
+    std::mutex reload_m_;
+    bool reloading_{false};
+    bool reload_pending_{false};
+    std::thread reload_thread_;
+};
+
+//! Blocking client of query_server_t
+class query_client_t {
+public:
+    explicit query_client_t(const std::string& socket_path) {
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            throw std::invalid_argument("socket path is too long: " + socket_path);
+        }
+        fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            int err = errno;
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+            throw std::system_error(err, std::generic_category(), "failed to connect to " + socket_path);
+        }
+    }
+    ~query_client_t() {
+        close(fd_);
+    }
+    query_client_t(const query_client_t&) = delete;
+    query_client_t& operator=(const query_client_t&) = delete;
+
+    //! Same result as filter2(pool, positions, vals) on the server pool sorted descending
+    ipv4_vec filter(const ipv4_t& positions, const std::vector<int>& vals) {
+        std::string payload;
+        for (auto v: positions) {
+            query_proto::put(payload, uint8_t(v ? 1 : 0));
+        }
+        query_proto::put(payload, uint8_t(vals.size()));
+        for (auto v: vals) {
+            query_proto::put(payload, int16_t(v));
+        }
+        return call(query_proto::op_filter, payload);
+    }
+
+    //! Same result as filter_positions(pool, vals) on the server pool sorted descending
+    ipv4_vec filter_positions(const ipv4_t& vals) {
+        std::string payload;
+        for (auto v: vals) {
+            query_proto::put(payload, int16_t(v));
+        }
+        return call(query_proto::op_filter_positions, payload);
+    }
+
+    //! Asks server to reload its pool file in background
+    void reload() {
+        call(query_proto::op_reload, {});
+    }
+
+private:
+    ipv4_vec call(uint8_t op, const std::string& payload) {
+        write_all(query_proto::make_request(op, payload));
+        char header[query_proto::response_header_size];
+        read_all(header, sizeof(header));
+        if (uint8_t(header[0]) != query_proto::status_ok) {
+            throw std::runtime_error("query server rejected request");
+        }
+        std::vector<char> data(4 * std::size_t(query_proto::get<uint32_t>(header + 1)));
+        read_all(data.data(), data.size());
+        ipv4_vec result(data.size() / 4);
+        for (std::size_t i = 0; i < result.size(); ++i) {
+            for (std::size_t j = 0; j < 4; ++j) {
+                result[i][j] = uint8_t(data[4 * i + j]);
+            }
+        }
+        return result;
+    }
+
+    void write_all(const std::string& buf) {
+        for (std::size_t pos = 0; pos < buf.size();) {
+            ssize_t n = send(fd_, buf.data() + pos, buf.size() - pos, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::system_error(errno, std::generic_category(), "failed to send request");
+            }
+            pos += static_cast<std::size_t>(n);
+        }
+    }
+
+    void read_all(char* buf, std::size_t size) {
+        for (std::size_t pos = 0; pos < size;) {
+            ssize_t n = read(fd_, buf + pos, size - pos);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error("query server closed connection");
+            }
+            pos += static_cast<std::size_t>(n);
+        }
+    }
+
+    int fd_{-1};
+};
+
+#endif //IP_FILTER_QUERY_SERVER_H
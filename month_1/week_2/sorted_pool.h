@@ -0,0 +1,150 @@
+#ifndef IP_FILTER_SORTED_POOL_H
+#define IP_FILTER_SORTED_POOL_H
+
+#include "ip_filter.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+//! Sorted pool of IPv4 addresses maintained incrementally
+/*!
+ * LSM-style container: the bulk of addresses lives in one sorted base vector, inserted batches are
+ * sorted on arrival and kept as separate runs, removed addresses are kept as tombstones. Runs are
+ * merged together once there are more than max_runs of them, and into the base when the sorted pool
+ * is requested. Applying k updates to a pool of n addresses costs O(k log k + n) instead of
+ * O((n + k) log (n + k)) for re-sorting from scratch.
+ *
+ * Example:
+ * \code
+ *
+ * sorted_pool_t pool({{1,2,3,4}, {3,2,4,5}}, false);
+ * pool.insert({{4,7,2,7}, {1,2,3,1}});
+ * pool.remove({{3,2,4,5}});
+ *
+ * print_ip_pool(pool.pool());
+ * // Output:
+ * // 4.7.2.7
+ * // 1.2.3.4
+ * // 1.2.3.1
+ *
+ * print_ip_pool(filter(pool.pool(), {1,0,0,0}, 1));
+ *
+ * \endcode
+*/
+class sorted_pool_t {
+public:
+    //! Creates pool from unsorted addresses, sorts them once
+    explicit sorted_pool_t(ipv4_vec ip_pool = {}, bool ascending = true, std::size_t max_runs = 8)
+        : base_(std::move(ip_pool)), ascending_(ascending), max_runs_(std::max<std::size_t>(max_runs, 1)) {
+        sort(base_, ascending_);
+    }
+
+    bool ascending() const {
+        return ascending_;
+    }
+
+    //! Adds batch of addresses
+    void insert(ipv4_vec batch) {
+        if (batch.empty()) {
+            return;
+        }
+        sort(batch, ascending_);
+        runs_.push_back(std::move(batch));
+        if (runs_.size() > max_runs_) {
+            merge_runs();
+        }
+    }
+
+    //! Removes one occurrence of each address in batch, addresses that are not in the pool are ignored
+    /*!
+     * Removals are applied after all pending inserts, so an address inserted and removed between two
+     * calls of pool() is not in the pool regardless of the order of calls.
+    */
+    void remove(ipv4_vec batch) {
+        removed_.insert(removed_.end(), batch.begin(), batch.end());
+    }
+
+    //! Number of inserted and removed addresses not yet merged into the sorted pool
+    std::size_t pending() const {
+        std::size_t n = removed_.size();
+        for (const auto& run: runs_) {
+            n += run.size();
+        }
+        return n;
+    }
+
+    //! Sorted pool with all updates applied, suitable for print_ip_pool and filter functions
+    const ipv4_vec& pool() {
+        if (!runs_.empty() || !removed_.empty()) {
+            compact();
+        }
+        return base_;
+    }
+
+private:
+    template<typename Compare>
+    static void merge_into(ipv4_vec& dst, const ipv4_vec& src, Compare cmp) {
+        ipv4_vec out;
+        out.reserve(dst.size() + src.size());
+        std::merge(dst.begin(), dst.end(), src.begin(), src.end(), std::back_inserter(out), cmp);
+        dst.swap(out);
+    }
+
+    template<typename Compare>
+    void merge_runs(Compare cmp) {
+        // merge pairwise so that each address is copied O(log runs) times
+        while (runs_.size() > 1) {
+            std::vector<ipv4_vec> merged;
+            for (std::size_t i = 0; i + 1 < runs_.size(); i += 2) {
+                merge_into(runs_[i], runs_[i + 1], cmp);
+                merged.push_back(std::move(runs_[i]));
+            }
+            if (runs_.size() % 2) {
+                merged.push_back(std::move(runs_.back()));
+            }
+            runs_.swap(merged);
+        }
+    }
+
+    template<typename Compare>
+    void compact(Compare cmp) {
+        merge_runs(cmp);
+        if (!runs_.empty()) {
+            merge_into(base_, runs_.front(), cmp);
+            runs_.clear();
+        }
+        if (!removed_.empty()) {
+            std::sort(removed_.begin(), removed_.end(), cmp);
+            ipv4_vec out;
+            out.reserve(base_.size());
+            std::set_difference(base_.begin(), base_.end(), removed_.begin(), removed_.end(),
+                                std::back_inserter(out), cmp);
+            base_.swap(out);
+            removed_.clear();
+        }
+    }
+
+    void merge_runs() {
+        if (ascending_)
+            merge_runs(std::less<ipv4_t>());
+        else
+            merge_runs(std::greater<ipv4_t>());
+    }
+
+    void compact() {
+        if (ascending_)
+            compact(std::less<ipv4_t>());
+        else
+            compact(std::greater<ipv4_t>());
+    }
+
+    ipv4_vec base_;
+    std::vector<ipv4_vec> runs_;
+    ipv4_vec removed_;
+    bool ascending_;
+    std::size_t max_runs_;
+};
+
+#endif //IP_FILTER_SORTED_POOL_H
@@ -0,0 +1,187 @@
+#include "compressed_input.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include <gtest/gtest.h>
+
+
+namespace {
+
+//! Writes data into a temporary file rewound to the beginning
+std::FILE* make_input(const std::string& data) {
+    std::FILE* f = std::tmpfile();
+    std::fwrite(data.data(), 1, data.size(), f);
+    std::fflush(f);
+    std::rewind(f);
+    return f;
+}
+
+//! Reads all blocks of input
+std::string read_all(input_reader_t& input) {
+    std::string text;
+    std::vector<char> buf;
+    for (std::size_t n; (n = input.next(buf)) > 0;) {
+        text.append(buf.data(), n);
+    }
+    return text;
+}
+
+std::string make_text(int lines) {
+    std::string text;
+    for (int i = 0; i < lines; ++i) {
+        text += std::to_string(i % 223) + '.' + std::to_string(i * 7 % 256) + '.' + std::to_string(i * 13 % 256) +
+                '.' + std::to_string(i * 31 % 256) + '\t' + std::to_string(i) + "\t0\n";
+    }
+    return text;
+}
+
+}
+
+
+TEST(CompressedInput, Plain) {
+    const auto text = make_text(100000);
+    std::FILE* f = make_input(text);
+    input_reader_t input(fileno(f));
+    EXPECT_EQ(input.format(), input_format_t::plain);
+    EXPECT_EQ(read_all(input), text);
+    std::fclose(f);
+}
+
+#ifdef IP_FILTER_WITH_ZLIB
+
+namespace {
+
+std::string gzip_compress(const std::string& text) {
+    z_stream zs{};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&zs, static_cast<uLong>(text.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    zs.avail_in = static_cast<uInt>(text.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+}
+
+
+TEST(CompressedInput, GzipMembers) {
+    // concatenated members as produced by `cat a.gz b.gz`
+    const auto a = make_text(100000);
+    const auto b = make_text(1000);
+    std::FILE* f = make_input(gzip_compress(a) + gzip_compress(b));
+    input_reader_t input(fileno(f));
+    EXPECT_EQ(input.format(), input_format_t::gzip);
+    EXPECT_EQ(read_all(input), a + b);
+    std::fclose(f);
+}
+
+
+TEST(CompressedInput, Bgzf) {
+    // several decoding jobs, decoded in parallel and returned in order
+    const auto text = make_text(1000000);
+    const auto compressed = bgzf_compress(text.data(), text.size());
+    ASSERT_GT(compressed.size(), 2 * input_reader_t::job_size);
+    EXPECT_EQ(detect_input_format(compressed.data(), compressed.size()), input_format_t::bgzf);
+
+    std::FILE* f = make_input(compressed);
+    input_reader_t input(fileno(f), 3);
+    EXPECT_EQ(input.format(), input_format_t::bgzf);
+    EXPECT_EQ(read_all(input), text);
+    std::fclose(f);
+}
+
+
+TEST(CompressedInput, GzipTruncated) {
+    const auto text = make_text(100000);
+    auto compressed = gzip_compress(text);
+    compressed.resize(compressed.size() / 2);
+    std::FILE* f = make_input(compressed);
+    input_reader_t input(fileno(f));
+    EXPECT_THROW(read_all(input), std::runtime_error);
+    std::fclose(f);
+}
+
+
+TEST(CompressedInput, BgzfEofBlock) {
+    // compressed data ends exactly where a job is cut, so the EOF block forms a job on its own
+    const auto text = make_text(1000000);
+    std::string compressed;
+    std::size_t size = 0;
+    while (compressed.size() < input_reader_t::job_size) {
+        const std::size_t n = std::min<std::size_t>(0xff00, text.size() - size);
+        compressed += bgzf_compress(text.data() + size, n);
+        size += n;
+    }
+    std::FILE* f = make_input(compressed + bgzf_eof_block());
+    input_reader_t input(fileno(f), 2);
+    EXPECT_EQ(read_all(input), text.substr(0, size));
+    std::fclose(f);
+
+    // bgzip output for empty input
+    f = make_input(bgzf_eof_block());
+    input_reader_t empty(fileno(f));
+    EXPECT_EQ(empty.format(), input_format_t::bgzf);
+    EXPECT_EQ(read_all(empty), "");
+    std::fclose(f);
+}
+
+
+TEST(CompressedInput, BgzfTruncated) {
+    const auto text = make_text(10000);
+    auto compressed = bgzf_compress(text.data(), text.size());
+    compressed.resize(compressed.size() - 10);
+    std::FILE* f = make_input(compressed);
+    input_reader_t input(fileno(f));
+    EXPECT_THROW(read_all(input), std::runtime_error);
+    std::fclose(f);
+}
+
+#endif
+
+
+#ifdef IP_FILTER_WITH_ZSTD
+
+TEST(CompressedInput, Zstd) {
+    auto zstd_compress = [](const std::string& text) {
+        std::string out(ZSTD_compressBound(text.size()), '\0');
+        out.resize(ZSTD_compress(&out[0], out.size(), text.data(), text.size(), 1));
+        return out;
+    };
+
+    // one frame
+    const auto text = make_text(100000);
+    std::FILE* f = make_input(zstd_compress(text));
+    input_reader_t single(fileno(f));
+    EXPECT_EQ(single.format(), input_format_t::zstd);
+    EXPECT_EQ(read_all(single), text);
+    std::fclose(f);
+
+    // several frames spanning several jobs, as written by `zstd -T0` or concatenated files
+    std::string compressed;
+    std::string expected;
+    for (int i = 0; i < 40; ++i) {
+        const auto part = make_text(20000 + i);
+        compressed += zstd_compress(part);
+        expected += part;
+    }
+    ASSERT_GT(compressed.size(), 2 * input_reader_t::job_size);
+    f = make_input(compressed);
+    input_reader_t multi(fileno(f), 3);
+    EXPECT_EQ(read_all(multi), expected);
+    std::fclose(f);
+
+    // truncated frame
+    compressed.resize(compressed.size() - 10);
+    f = make_input(compressed);
+    input_reader_t truncated(fileno(f));
+    EXPECT_THROW(read_all(truncated), std::runtime_error);
+    std::fclose(f);
+}
+
+#endif
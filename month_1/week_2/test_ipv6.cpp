@@ -0,0 +1,116 @@
+#include "ipv6.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+
+TEST(IPv6, Parse) {
+    const ipv6_t a{0x20010db800000000ull, 1};
+    EXPECT_EQ(parse_ipv6("2001:0db8:0000:0000:0000:0000:0000:0001"), a);
+    EXPECT_EQ(parse_ipv6("2001:db8:0:0:0:0:0:1"), a);
+    EXPECT_EQ(parse_ipv6("2001:DB8::1"), a);
+    EXPECT_EQ(parse_ipv6("::"), ipv6_t{});
+    EXPECT_EQ(parse_ipv6("::1"), (ipv6_t{0, 1}));
+    EXPECT_EQ(parse_ipv6("fe80::"), (ipv6_t{0xfe80000000000000ull, 0}));
+    EXPECT_EQ(parse_ipv6("1:2:3:4:5:6::8"), (ipv6_t{0x0001000200030004ull, 0x0005000600000008ull}));
+    EXPECT_EQ(parse_ipv6("::ffff:46.70.113.73"), ipv4_to_ipv6({46, 70, 113, 73}));
+    EXPECT_EQ(parse_ipv6("64:ff9b::192.0.2.33"), (ipv6_t{0x0064ff9b00000000ull, 0xc0000221ull}));
+
+    for (const char* bad: {"", ":", ":::", "1:2", "1::2::3", "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7::8", "12345::",
+                           "1:", ":1", "g::1", "::ffff:1.2.3", "::ffff:1.2.3.256", "::1.2.3.4:5", "1:2:3:4:5:6:7:1.2.3.4"}) {
+        EXPECT_THROW(parse_ipv6(bad), std::invalid_argument) << bad;
+    }
+}
+
+
+TEST(IPv6, Format) {
+    EXPECT_EQ(format_ipv6(parse_ipv6("2001:0DB8:0:0:0:0:0:1")), "2001:db8::1");
+    EXPECT_EQ(format_ipv6(parse_ipv6("2001:db8:0:1:0:0:0:1")), "2001:db8:0:1::1");
+    EXPECT_EQ(format_ipv6(parse_ipv6("2001:0:0:1:0:0:1:1")), "2001::1:0:0:1:1");
+    EXPECT_EQ(format_ipv6(parse_ipv6("::")), "::");
+    EXPECT_EQ(format_ipv6(parse_ipv6("fe80::")), "fe80::");
+    EXPECT_EQ(format_ipv6(ipv4_to_ipv6({46, 70, 1, 2})), "::ffff:46.70.1.2");
+}
+
+
+TEST(IPv6, RadixSort) {
+    std::mt19937_64 gen(1);
+    ipv6_vec ip_pool;
+    for (int i = 0; i < 10000; ++i) {
+        // shared prefixes and IPv4-mapped addresses leave some byte positions constant
+        switch (i % 3) {
+            case 0: ip_pool.push_back({gen(), gen()}); break;
+            case 1: ip_pool.push_back({0x20010db800000000ull | (gen() & 0xffff), gen()}); break;
+            default: ip_pool.push_back(ipv4_to_ipv6({int(gen() % 256), int(gen() % 256), 1, 2}));
+        }
+    }
+    for (bool ascending: {true, false}) {
+        auto expected = ip_pool;
+        if (ascending) {
+            std::sort(expected.begin(), expected.end());
+        }
+        else {
+            std::sort(expected.begin(), expected.end(), std::greater<ipv6_t>());
+        }
+        auto sorted = ip_pool;
+        sort(sorted, ascending);
+        EXPECT_EQ(sorted, expected);
+    }
+}
+
+
+TEST(IPv6, Filter) {
+    const ipv6_vec ip_pool = {
+        parse_ipv6("2001:db8::1"),
+        parse_ipv6("2001:db8:1::2"),
+        parse_ipv6("2001:db9::1"),
+        ipv4_to_ipv6({46, 70, 113, 73}),
+        ipv4_to_ipv6({46, 71, 0, 1}),
+    };
+    EXPECT_EQ(filter(ip_pool, parse_ipv6_filter("2001:db8::/32")), ipv6_vec(ip_pool.begin(), ip_pool.begin() + 2));
+    EXPECT_EQ(filter(ip_pool, parse_ipv6_filter("::ffff:46.70.0.0/112")), ipv6_vec{ip_pool[3]});
+    EXPECT_EQ(filter(ip_pool, parse_ipv6_filter("::/0")), ip_pool);
+    EXPECT_EQ(filter(ip_pool, parse_ipv6_filter("2001:db*:*:*:*:*:*:1")), (ipv6_vec{ip_pool[0], ip_pool[2]}));
+    // last byte of IPv4-mapped address, like filter_positions(ip_pool, {-1,-1,-1,1})
+    EXPECT_EQ(filter(ip_pool, parse_ipv6_filter("0:0:0:0:0:ffff:*:**01")), ipv6_vec{ip_pool[4]});
+
+    EXPECT_THROW(parse_ipv6_filter("2001:db8::/129"), std::invalid_argument);
+    EXPECT_THROW(parse_ipv6_filter("2001:db8::*"), std::invalid_argument);
+}
+
+
+TEST(IPv6, MixedInput) {
+    const std::string text = "46.70.113.73\t1\t0\n2001:db8::1\t2\t0\n\n::ffff:1.2.3.4\t3\t0\n1.1.234.8\t4\t0";
+    std::FILE* f = std::tmpfile();
+    std::fwrite(text.data(), 1, text.size(), f);
+    std::fflush(f);
+    std::rewind(f);
+    block_reader_t input(fileno(f));
+    auto ip_pool = read_ip_pool<ipv6_vec>(input);
+    std::fclose(f);
+
+    const ipv6_vec expected = {
+        ipv4_to_ipv6({46, 70, 113, 73}),
+        parse_ipv6("2001:db8::1"),
+        ipv4_to_ipv6({1, 2, 3, 4}),
+        ipv4_to_ipv6({1, 1, 234, 8}),
+    };
+    EXPECT_EQ(ip_pool, expected);
+}
+
+
+TEST(IPv6, MixedInputRejectsBadIPv4) {
+    for (const char* bad: {"256.1.1.1\t1\t0\n", "1.2.3.4junk\t1\t0\n", "1.2.3\t1\t0\n", "1.2.3.4.5\t1\t0\n",
+                           "1.2.3.0004\t1\t0\n", "2001:db8::1\t1\t0\n1.2.3.999\n"}) {
+        const std::string text = bad;
+        ipv6_vec ip_pool;
+        EXPECT_THROW(parse_ip_lines(text.data(), text.data() + text.size(), ip_pool), std::invalid_argument) << bad;
+    }
+    const std::string text = "255.0.10.1\t1\t0\n";
+    ipv6_vec ip_pool;
+    parse_ip_lines(text.data(), text.data() + text.size(), ip_pool);
+    EXPECT_EQ(ip_pool, ipv6_vec{ipv4_to_ipv6({255, 0, 10, 1})});
+}
@@ -0,0 +1,111 @@
+#include "pipeline.h"
+
+#include <cstdio>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(Pipeline, ParseIPv4) {
+    const std::string line = "113.162.145.156\t111\t0";
+    auto a = parse_ipv4(line.data(), line.data() + line.find('\t'));
+    EXPECT_THAT(a, testing::ContainerEq(ipv4_t{113, 162, 145, 156}));
+
+    const std::string min_max = "0.255.0.255";
+    EXPECT_THAT(parse_ipv4(min_max.data(), min_max.data() + min_max.size()), testing::ContainerEq(ipv4_t{0, 255, 0, 255}));
+
+    for (const std::string bad: {"113.162.145", "256.1.1.1", "1.2.3.4junk", "99999999999.1.1.1", "46.70.1.2.3",
+                                 "1.2.3.0004", "1..2.3", ".1.2.3", "1.2.3.", "1.2.3.4 ", "-1.2.3.4", ""}) {
+        EXPECT_THROW(parse_ipv4(bad.data(), bad.data() + bad.size()), std::invalid_argument) << bad;
+    }
+}
+
+
+TEST(Pipeline, RejectsMalformedLines) {
+    for (const std::string bad: {"256.1.1.1\t1\t0\n", "1.2.3.4junk\t1\t0\n", "99999999999.1.1.1\t1\t0\n",
+                                 "46.70.1.2.3\t1\t0\n", "1.1.1.1\t1\t0\n46.70.1.2.3\n"}) {
+        ipv4_vec pool;
+        EXPECT_THROW(parse_ip_lines(bad.data(), bad.data() + bad.size(), pool), std::invalid_argument) << bad;
+
+        std::FILE* in = std::tmpfile();
+        ASSERT_NE(in, nullptr);
+        std::fwrite(bad.data(), 1, bad.size(), in);
+        std::fflush(in);
+        std::rewind(in);
+        std::FILE* out = std::tmpfile();
+        ASSERT_NE(out, nullptr);
+        EXPECT_THROW(run_pipeline(fileno(in), out, parse_pipeline_filter("any:1"), nullptr), std::invalid_argument) << bad;
+        // nothing is written before the bad line is reached in the same block
+        EXPECT_EQ(std::ftell(out), 0) << bad;
+        std::fclose(in);
+        std::fclose(out);
+    }
+}
+
+
+TEST(Pipeline, ParseFilter) {
+    auto f = parse_pipeline_filter("46.70.-1.-1");
+    EXPECT_FALSE(f.any);
+    EXPECT_THAT(f.vals, testing::ContainerEq(ipv4_t{46, 70, -1, -1}));
+
+    f = parse_pipeline_filter("any:46");
+    EXPECT_TRUE(f.any);
+    EXPECT_EQ(f.vals[0], 46);
+
+    EXPECT_THROW(parse_pipeline_filter("46.70"), std::invalid_argument);
+}
+
+
+TEST(Pipeline, MatchesPhasedFilter) {
+    // enough lines to span several input blocks, so lines are split between blocks
+    ipv4_vec ip_pool;
+    std::FILE* in = std::tmpfile();
+    ASSERT_NE(in, nullptr);
+    for (int i = 0; i < 200000; ++i) {
+        ipv4_t a{(i * 7) % 256, (i * 13) % 256, (i * 31) % 256, i % 256};
+        ip_pool.push_back(a);
+        std::fprintf(in, "%d.%d.%d.%d\t%d\t0\n", a[0], a[1], a[2], a[3], i);
+    }
+    std::fflush(in);
+    std::rewind(in);
+
+    std::FILE* out = std::tmpfile();
+    ASSERT_NE(out, nullptr);
+    pipeline_stats_t stats;
+    run_pipeline(fileno(in), out, parse_pipeline_filter("any:46"), &stats);
+
+    std::ostringstream ref;
+    for (const auto& a: filter(ip_pool, {1,1,1,1}, 46)) {
+        ref << a[0] << '.' << a[1] << '.' << a[2] << '.' << a[3] << '\n';
+    }
+    std::rewind(out);
+    std::string text;
+    char buf[4096];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), out)) > 0;) {
+        text.append(buf, n);
+    }
+    std::fclose(in);
+    std::fclose(out);
+
+    EXPECT_EQ(stats.records, ip_pool.size());
+    EXPECT_GT(stats.matches, 0u);
+    EXPECT_GE(stats.first_output_ns, 0);
+    EXPECT_EQ(text, ref.str());
+}
+
+
+TEST(Pipeline, BoundedQueueClose) {
+    bounded_queue_t<int> q(2);
+    EXPECT_TRUE(q.push(1));
+    EXPECT_TRUE(q.push(2));
+    q.close();
+    EXPECT_FALSE(q.push(3)) << "Push must fail after close";
+
+    int v = 0;
+    EXPECT_TRUE(q.pop(v));
+    EXPECT_EQ(v, 1);
+    EXPECT_TRUE(q.pop(v));
+    EXPECT_EQ(v, 2);
+    EXPECT_FALSE(q.pop(v)) << "Pop must fail on closed empty queue";
+}
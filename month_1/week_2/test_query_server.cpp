@@ -0,0 +1,247 @@
+#include "query_server.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+ipv4_vec make_pool(int size, int first) {
+    ipv4_vec ip_pool;
+    for (int i = 0; i < size; ++i) {
+        ip_pool.push_back({(first + i * 7) % 256, (i * 13) % 256, (i * 31) % 256, i % 256});
+    }
+    return ip_pool;
+}
+
+void write_pool(const std::string& path, const ipv4_vec& ip_pool) {
+    std::ofstream os(path);
+    for (const auto& a: ip_pool) {
+        os << a[0] << '.' << a[1] << '.' << a[2] << '.' << a[3] << "\t1\t0\n";
+    }
+}
+
+//! Runs server on a background thread for the lifetime of the object
+struct server_thread_t {
+    explicit server_thread_t(query_server_t& server): thread([&server, this]() { server.run(stop); }) {}
+    ~server_thread_t() {
+        stop = true;
+        thread.join();
+    }
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+const std::string socket_path = "test_query_server.sock";
+
+}
+
+
+TEST(QueryServer, MatchesFilters) {
+    auto ip_pool = make_pool(20000, 0);
+    query_server_t server(socket_path, ip_pool);
+    server_thread_t running(server);
+
+    sort(ip_pool, false);
+    query_client_t client(socket_path);
+    EXPECT_THAT(client.filter_positions({46,70,-1,-1}), testing::ContainerEq(filter_positions(ip_pool, {46,70,-1,-1})));
+    EXPECT_THAT(client.filter_positions({-1,13,-1,-1}), testing::ContainerEq(filter_positions(ip_pool, {-1,13,-1,-1})));
+    EXPECT_THAT(client.filter({1,0,0,0}, {1}), testing::ContainerEq(filter(ip_pool, {1,0,0,0}, 1)));
+    EXPECT_THAT(client.filter({1,1,1,1}, {46}), testing::ContainerEq(filter(ip_pool, {1,1,1,1}, 46)));
+    EXPECT_THAT(client.filter({1,1,0,0}, {46, 70}), testing::ContainerEq(filter2(ip_pool, {1,1,0,0}, {46, 70})));
+    // reload needs a pool file
+    EXPECT_THROW(client.reload(), std::runtime_error);
+}
+
+
+TEST(QueryServer, ConcurrentClientsAndReload) {
+    const std::string pool_path = "test_query_server.tsv";
+    write_pool(pool_path, make_pool(20000, 0));
+    query_server_t server(socket_path, pool_path);
+    server_thread_t running(server);
+
+    auto old_pool = make_pool(20000, 0);
+    auto new_pool = make_pool(30000, 1);
+    sort(old_pool, false);
+    sort(new_pool, false);
+    const auto old_result = filter_positions(old_pool, {46,-1,-1,-1});
+    const auto new_result = filter_positions(new_pool, {46,-1,-1,-1});
+    ASSERT_NE(old_result, new_result);
+
+    // every answer comes from exactly one snapshot, either before or after reload
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> clients;
+    for (int t = 0; t < 4; ++t) {
+        clients.emplace_back([&]() {
+            query_client_t client(socket_path);
+            for (int i = 0; i < 200; ++i) {
+                auto result = client.filter_positions({46,-1,-1,-1});
+                if (result != old_result && result != new_result) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    write_pool(pool_path, make_pool(30000, 1));
+    query_client_t client(socket_path);
+    client.reload();
+    for (auto& t: clients) {
+        t.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    for (int i = 0; i < 500 && server.reloads() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(server.reloads(), 1u);
+    EXPECT_THAT(client.filter_positions({46,-1,-1,-1}), testing::ContainerEq(new_result));
+    std::remove(pool_path.c_str());
+}
+
+
+TEST(QueryServer, ClientGoneBeforeReply) {
+    // reply to a match-all query is far larger than the socket buffer
+    query_server_t server(socket_path, make_pool(200000, 0));
+    server_thread_t running(server);
+
+    for (int i = 0; i < 3; ++i) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_GE(fd, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+        std::string payload;
+        for (int v: {-1, -1, -1, -1}) {
+            query_proto::put(payload, int16_t(v));
+        }
+        const auto request = query_proto::make_request(query_proto::op_filter_positions, payload);
+        ASSERT_EQ(write(fd, request.data(), request.size()), ssize_t(request.size()));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        close(fd);
+    }
+
+    // the server is still serving
+    query_client_t client(socket_path);
+    EXPECT_EQ(client.filter_positions({-1,-1,-1,-1}).size(), 200000u);
+}
+
+
+TEST(QueryServer, KeepsFilesThatAreNotSockets) {
+    const std::string path = "test_query_server.keep";
+    write_pool(path, make_pool(10, 0));
+    EXPECT_THROW(query_server_t(path, make_pool(10, 0)), std::runtime_error);
+    std::ifstream kept(path);
+    EXPECT_TRUE(kept.good()) << "regular file at socket path must not be removed";
+
+    // the destructor removes only the socket it bound, not a file put in its place later
+    {
+        query_server_t server(socket_path, make_pool(10, 0));
+        std::remove(socket_path.c_str());
+        write_pool(socket_path, make_pool(10, 0));
+    }
+    std::ifstream replaced(socket_path);
+    EXPECT_TRUE(replaced.good());
+    std::remove(socket_path.c_str());
+    std::remove(path.c_str());
+}
+
+
+TEST(QueryServer, PausesClientThatDoesNotRead) {
+    // 2000 addresses give 8 KB replies, the server stops reading after max_buffered_output of them
+    query_server_t server(socket_path, make_pool(2000, 0), 2);
+    server_thread_t running(server);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    std::string payload;
+    for (int v: {-1, -1, -1, -1}) {
+        query_proto::put(payload, int16_t(v));
+    }
+    const auto request = query_proto::make_request(query_proto::op_filter_positions, payload);
+
+    // pipeline requests without reading replies until the socket stops taking them
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    std::size_t sent = 0;
+    bool blocked = false;
+    for (int i = 0; i < 100000 && !blocked; ++i) {
+        ssize_t n = send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+            // the server may be about to read, give it time to reach the limit
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            blocked = send(fd, request.data(), request.size(), MSG_NOSIGNAL) < 0;
+            n = blocked ? 0 : ssize_t(request.size());
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    EXPECT_TRUE(blocked) << "server kept reading from a client that does not read its replies";
+
+    // other clients are served meanwhile
+    query_client_t client(socket_path);
+    EXPECT_EQ(client.filter_positions({-1,-1,-1,-1}).size(), 2000u);
+
+    // reading the replies resumes the paused client, every request is answered in full
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    const std::size_t reply_size = query_proto::response_header_size + 4 * 2000;
+    const std::size_t expected = sent / request.size() * reply_size;
+    std::vector<char> buf(1 << 16);
+    std::size_t received = 0;
+    while (received < expected) {
+        ssize_t n = read(fd, buf.data(), std::min(buf.size(), expected - received));
+        ASSERT_GT(n, 0);
+        received += static_cast<std::size_t>(n);
+    }
+    EXPECT_EQ(received, expected);
+    close(fd);
+}
+
+
+TEST(HazardPtr, ReadersNeverSeeFreedObject) {
+    struct value_t {
+        explicit value_t(int v): v(v) {}
+        ~value_t() { alive = 0; }
+        int v;
+        int alive{1};
+    };
+    // more readers than slots, so readers also wait for a free slot
+    hazard_ptr_t<value_t> ptr(std::unique_ptr<const value_t>(new value_t(0)), 3);
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 5; ++t) {
+        readers.emplace_back([&]() {
+            int last = 0;
+            while (!done) {
+                auto guard = ptr.read();
+                const int v = guard->v;
+                std::this_thread::yield();
+                // values only grow, and the object stays alive while the guard is held
+                if (v < last || guard->v != v || guard->alive != 1) {
+                    bad++;
+                }
+                last = v;
+            }
+        });
+    }
+    for (int i = 1; i <= 2000; ++i) {
+        ptr.store(std::unique_ptr<const value_t>(new value_t(i)));
+    }
+    done = true;
+    for (auto& t: readers) {
+        t.join();
+    }
+    EXPECT_EQ(bad, 0);
+    EXPECT_EQ(ptr.read()->v, 2000);
+}
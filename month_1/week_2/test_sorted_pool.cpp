@@ -0,0 +1,85 @@
+#include "sorted_pool.h"
+
+#include <random>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(SortedPool, InsertRemove) {
+    sorted_pool_t pool({
+        {222, 130, 177,  64},
+        {  1,  29, 168, 152},
+        {222,  82, 198,  61},
+    }, false);
+
+    pool.insert({
+        {  1,  70,  44, 170},
+        {  1,   1, 234,   8},
+    });
+    pool.insert({
+        {222, 173, 235, 246},
+    });
+    pool.remove({
+        {222,  82, 198,  61},
+        {  9,   9,   9,   9},
+    });
+    EXPECT_EQ(pool.pending(), 5u);
+
+    ipv4_vec ip_pool_ref = {
+        {222, 173, 235, 246},
+        {222, 130, 177,  64},
+        {  1,  70,  44, 170},
+        {  1,  29, 168, 152},
+        {  1,   1, 234,   8},
+    };
+    EXPECT_THAT(pool.pool(), testing::ContainerEq(ip_pool_ref));
+    EXPECT_EQ(pool.pending(), 0u);
+}
+
+
+TEST(SortedPool, Duplicates) {
+    sorted_pool_t pool({
+        {1, 1, 1, 1},
+        {1, 1, 1, 1},
+        {2, 2, 2, 2},
+    });
+
+    // only one occurrence is removed
+    pool.remove({{1, 1, 1, 1}});
+    pool.insert({{2, 2, 2, 2}});
+
+    ipv4_vec ip_pool_ref = {
+        {1, 1, 1, 1},
+        {2, 2, 2, 2},
+        {2, 2, 2, 2},
+    };
+    EXPECT_THAT(pool.pool(), testing::ContainerEq(ip_pool_ref));
+}
+
+
+TEST(SortedPool, MatchesFullSort) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> byte(0, 255);
+    auto random_batch = [&](std::size_t n) {
+        ipv4_vec batch(n);
+        for (auto& a: batch) {
+            a = {byte(gen), byte(gen), byte(gen), byte(gen)};
+        }
+        return batch;
+    };
+
+    ipv4_vec ip_pool = random_batch(1000);
+    sorted_pool_t pool(ip_pool, true, 3);
+    // more batches than max_runs to trigger merging of runs
+    for (int i = 0; i < 10; ++i) {
+        auto batch = random_batch(17);
+        ip_pool.insert(ip_pool.end(), batch.begin(), batch.end());
+        pool.insert(batch);
+    }
+    sort(ip_pool, true);
+
+    EXPECT_THAT(pool.pool(), testing::ContainerEq(ip_pool));
+    EXPECT_THAT(filter_positions(pool.pool(), {46, 70, -1, -1}),
+                testing::ContainerEq(filter_positions(ip_pool, {46, 70, -1, -1})));
+}
@@ -0,0 +1,58 @@
+#include "trace.h"
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+
+TEST(Trace, Disabled) {
+    trace_t trace(false);
+    {
+        auto phase = trace.phase("parse");
+        phase.add(10, 100);
+    }
+    EXPECT_FALSE(trace.enabled());
+    EXPECT_TRUE(trace.phases().empty()) << "Disabled trace must not record phases";
+}
+
+
+TEST(Trace, Phases) {
+    trace_t trace(true);
+    {
+        auto phase = trace.phase("parse");
+        phase.add(1, 10);
+        phase.add(2, 20);
+    }
+    {
+        auto phase = trace.phase("sort");
+        phase.add(3);
+    }
+
+    ASSERT_EQ(trace.phases().size(), 2u);
+    const auto& parse = trace.phases()[0];
+    const auto& sort = trace.phases()[1];
+    EXPECT_EQ(parse.name, "parse");
+    EXPECT_EQ(parse.records, 3u);
+    EXPECT_EQ(parse.bytes, 30u);
+    EXPECT_EQ(sort.name, "sort");
+    EXPECT_EQ(sort.records, 3u);
+    EXPECT_EQ(sort.bytes, 0u);
+    EXPECT_GE(parse.wall_ns, 0);
+    EXPECT_GE(sort.start_ns, parse.start_ns + parse.wall_ns) << "Phases must be ordered in time";
+}
+
+
+TEST(Trace, ChromeTrace) {
+    trace_t trace(true);
+    {
+        auto phase = trace.phase("filter");
+        phase.add(5);
+    }
+
+    std::ostringstream os;
+    trace.write_chrome_trace(os);
+    const auto json = os.str();
+    EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+    EXPECT_NE(json.find("\"name\":\"filter\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"records\":5"), std::string::npos);
+}
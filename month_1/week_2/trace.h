@@ -0,0 +1,276 @@
+#ifndef IP_FILTER_TRACE_H
+#define IP_FILTER_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//! Hardware counters of a single phase, all zero if perf events are not available
+struct hw_counters_t {
+    uint64_t cycles{0};
+    uint64_t cache_misses{0};
+    uint64_t branch_misses{0};
+};
+
+//! Group of cycles, cache misses and branch misses counters of the calling thread
+/*!
+ * Opened with perf_event_open, if the kernel or permissions (perf_event_paranoid) do not allow it
+ * available() returns false and read() returns zeros.
+*/
+class hw_counter_group_t {
+public:
+    hw_counter_group_t() {
+#ifdef __linux__
+        const uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < 3; ++i) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+            if (fds_[i] < 0) {
+                close_all();
+                return;
+            }
+        }
+        ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+    ~hw_counter_group_t() {
+        close_all();
+    }
+    hw_counter_group_t(const hw_counter_group_t&) = delete;
+    hw_counter_group_t& operator=(const hw_counter_group_t&) = delete;
+
+    bool available() const {
+        return fds_[0] >= 0;
+    }
+
+    //! Current values of running counters
+    hw_counters_t read() const {
+        hw_counters_t c;
+#ifdef __linux__
+        uint64_t buf[4] = {};
+        if (available() && ::read(fds_[0], buf, sizeof(buf)) == sizeof(buf)) {
+            c.cycles = buf[1];
+            c.cache_misses = buf[2];
+            c.branch_misses = buf[3];
+        }
+#endif
+        return c;
+    }
+
+private:
+    void close_all() {
+#ifdef __linux__
+        for (auto& fd: fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+#endif
+    }
+
+    int fds_[3] = {-1, -1, -1};
+};
+
+//! Per-phase instrumentation of ip_filter run
+/*!
+ * Each phase records wall and CPU time, processed records and bytes and, if enabled, hardware counters.
+ * Disabled trace costs a single branch per phase.
+ *
+ * Example:
+ * \code
+ *
+ * trace_t trace(true);
+ * {
+ *     auto phase = trace.phase("sort");
+ *     sort(ip_pool, false);
+ *     phase.add(ip_pool.size());
+ * }
+ * trace.print_summary(std::cerr);
+ *
+ * \endcode
+*/
+class trace_t {
+public:
+    struct phase_t {
+        std::string name;
+        int64_t start_ns{0};
+        int64_t wall_ns{0};
+        int64_t cpu_ns{0};
+        uint64_t records{0};
+        uint64_t bytes{0};
+        hw_counters_t hw;
+    };
+
+    //! RAII scope of a running phase, finishes the phase on destruction
+    class scope_t {
+    public:
+        scope_t(trace_t* trace, const char* name): trace_(trace) {
+            if (trace_) {
+                index_ = trace_->begin(name);
+            }
+        }
+        scope_t(scope_t&& rhs) noexcept: trace_(rhs.trace_), index_(rhs.index_) {
+            rhs.trace_ = nullptr;
+        }
+        scope_t(const scope_t&) = delete;
+        scope_t& operator=(const scope_t&) = delete;
+        scope_t& operator=(scope_t&&) = delete;
+        ~scope_t() {
+            if (trace_) {
+                trace_->end(index_);
+            }
+        }
+
+        //! Accounts processed records and bytes to the phase
+        void add(uint64_t records, uint64_t bytes = 0) {
+            if (trace_) {
+                trace_->phases_[index_].records += records;
+                trace_->phases_[index_].bytes += bytes;
+            }
+        }
+
+    private:
+        trace_t* trace_;
+        size_t index_{0};
+    };
+
+    explicit trace_t(bool enabled, bool hw_counters = false): enabled_(enabled) {
+        if (enabled_ && hw_counters) {
+            counters_.reset(new hw_counter_group_t());
+            if (!counters_->available()) {
+                counters_.reset();
+            }
+        }
+    }
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    bool hw_counters() const {
+        return counters_ != nullptr;
+    }
+
+    scope_t phase(const char* name) {
+        return scope_t(enabled_ ? this : nullptr, name);
+    }
+
+    const std::vector<phase_t>& phases() const {
+        return phases_;
+    }
+
+    //! Prints human readable table of phases
+    void print_summary(std::ostream& os) const {
+        os << std::left << std::setw(24) << "phase" << std::right
+           << std::setw(12) << "wall, ms" << std::setw(12) << "cpu, ms"
+           << std::setw(14) << "records/s" << std::setw(12) << "MB/s";
+        if (hw_counters()) {
+            os << std::setw(16) << "cycles" << std::setw(14) << "cache-miss" << std::setw(14) << "branch-miss";
+        }
+        os << "\n";
+        for (const auto& p: phases_) {
+            const double sec = p.wall_ns * 1e-9;
+            os << std::left << std::setw(24) << p.name << std::right << std::fixed << std::setprecision(3)
+               << std::setw(12) << p.wall_ns * 1e-6 << std::setw(12) << p.cpu_ns * 1e-6
+               << std::setprecision(0)
+               << std::setw(14) << (sec > 0 ? p.records / sec : 0.0)
+               << std::setprecision(1)
+               << std::setw(12) << (sec > 0 ? p.bytes / sec / 1e6 : 0.0);
+            if (hw_counters()) {
+                os << std::setw(16) << p.hw.cycles << std::setw(14) << p.hw.cache_misses
+                   << std::setw(14) << p.hw.branch_misses;
+            }
+            os << "\n";
+        }
+        os.unsetf(std::ios::floatfield);
+    }
+
+    //! Writes phases in Chrome trace event format (chrome://tracing, Perfetto)
+    void write_chrome_trace(std::ostream& os) const {
+        os << "{\"traceEvents\":[";
+        for (size_t i = 0; i < phases_.size(); ++i) {
+            const auto& p = phases_[i];
+            os << (i ? "," : "") << "\n{\"name\":\"" << p.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+               << ",\"ts\":" << p.start_ns / 1000 << ",\"dur\":" << p.wall_ns / 1000
+               << ",\"args\":{\"cpu_us\":" << p.cpu_ns / 1000 << ",\"records\":" << p.records
+               << ",\"bytes\":" << p.bytes;
+            if (hw_counters()) {
+                os << ",\"cycles\":" << p.hw.cycles << ",\"cache_misses\":" << p.hw.cache_misses
+                   << ",\"branch_misses\":" << p.hw.branch_misses;
+            }
+            os << "}}";
+        }
+        os << "\n]}\n";
+    }
+
+private:
+    static int64_t wall_now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point()).count();
+    }
+
+    static int64_t cpu_now_ns() {
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+        timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return int64_t(std::clock()) * (1000000000 / CLOCKS_PER_SEC);
+#endif
+    }
+
+    size_t begin(const char* name) {
+        if (!origin_ns_) {
+            origin_ns_ = wall_now_ns();
+        }
+        phase_t p;
+        p.name = name;
+        p.cpu_ns = cpu_now_ns();
+        if (counters_) {
+            p.hw = counters_->read();
+        }
+        p.start_ns = wall_now_ns() - origin_ns_;
+        phases_.push_back(p);
+        return phases_.size() - 1;
+    }
+
+    void end(size_t index) {
+        auto& p = phases_[index];
+        p.wall_ns = wall_now_ns() - origin_ns_ - p.start_ns;
+        p.cpu_ns = cpu_now_ns() - p.cpu_ns;
+        if (counters_) {
+            auto hw = counters_->read();
+            p.hw.cycles = hw.cycles - p.hw.cycles;
+            p.hw.cache_misses = hw.cache_misses - p.hw.cache_misses;
+            p.hw.branch_misses = hw.branch_misses - p.hw.branch_misses;
+        }
+    }
+
+    bool enabled_;
+    int64_t origin_ns_{0};
+    std::unique_ptr<hw_counter_group_t> counters_;
+    std::vector<phase_t> phases_;
+};
+
+#endif //IP_FILTER_TRACE_H
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Compares Google Benchmark JSON output against a stored baseline.
+
+Usage: bench_compare.py BASELINE.json CURRENT.json [--threshold 0.10]
+
+Exits with non-zero status if any benchmark present in both files became
+slower than the baseline by more than the threshold (relative real time).
+"""
+
+import argparse
+import json
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    times = {}
+    for b in data["benchmarks"]:
+        # with repetitions prefer the median aggregate, otherwise the fastest run
+        if b.get("run_type") == "aggregate" and b.get("aggregate_name") != "median":
+            continue
+        name = b.get("run_name", b["name"])
+        t = b["real_time"] * TIME_UNITS[b.get("time_unit", "ns")]
+        if b.get("run_type") == "aggregate" or name not in times:
+            times[name] = t
+        else:
+            times[name] = min(times[name], t)
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed relative slowdown, 0.10 means 10%%")
+    args = parser.parse_args()
+
+    try:
+        baseline = load(args.baseline)
+    except FileNotFoundError:
+        print("No baseline found at {}, build target bench_baseline first".format(args.baseline))
+        return 2
+    current = load(args.current)
+
+    print("{:<60} {:>12} {:>12} {:>7}".format("Benchmark, ns", "baseline", "current", "change"))
+    regressed = []
+    for name in sorted(current):
+        if name not in baseline:
+            print("{:<60} {:>12} {:>12.1f}      new".format(name, "-", current[name]))
+            continue
+        change = current[name] / baseline[name] - 1.0
+        mark = "REGRESSED" if change > args.threshold else ""
+        print("{:<60} {:>12.1f} {:>12.1f} {:>+7.1%} {}".format(
+            name, baseline[name], current[name], change, mark))
+        if mark:
+            regressed.append(name)
+
+    if regressed:
+        print("{} benchmark(s) regressed by more than {:.0%}".format(len(regressed), args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())